@@ -0,0 +1,121 @@
+// Compares request latency of the HTTP path (one connection per script)
+// with the binary protocol (one connection, sequential and pipelined).
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "boost/asio.hpp"
+#include "boost/lexical_cast.hpp"
+
+#include "dust/document.h"
+#include "dust/storage/mem_store.h"
+#include "dust-server/binary_protocol.h"
+#include "dust-server/http_service.h"
+#include "dust-server/options.h"
+
+using boost::asio::ip::tcp;
+namespace bp = dust_server::binary_protocol;
+
+namespace {
+
+const int kRequests = 2000;
+
+const char* kScript =
+    "function run(db)\n"
+    "  return db:get_document(\"bench\").counter:val()\n"
+    "end\n";
+
+class bench_options : public dust_server::options {
+ public:
+  bench_options() : options("127.0.0.1", "9200", "bench") {
+    binary_port_ = "9201";
+  }
+};
+
+template <typename F>
+double us_per_request(F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count()
+         / kRequests;
+}
+
+void read_response(tcp::socket& socket) {
+  char header[bp::kHeaderSize];
+  boost::asio::read(socket, boost::asio::buffer(header));
+  std::string payload(bp::get_u32(header), '\0');
+  boost::asio::read(socket, boost::asio::buffer(&payload[0], payload.size()));
+}
+
+}  // namespace
+
+int main() {
+  auto store = std::make_shared<dust::mem_store>();
+  dust::document(store, "bench")["counter"].assign("0");
+
+  boost::asio::io_service io_service;
+  dust_server::http_service service(&io_service, store, bench_options());
+  std::thread server([&]() { io_service.run(); });
+
+  boost::asio::io_service client_io;
+  tcp::resolver resolver(client_io);
+  auto http_ep = *resolver.resolve(tcp::resolver::query("127.0.0.1", "9200"));
+  auto binary_ep = *resolver.resolve(tcp::resolver::query("127.0.0.1", "9201"));
+
+  std::string script = kScript;
+  std::string http_request =
+      "POST / HTTP/1.0\r\n"
+      "Authorization: Basic YWRtaW46YmVuY2g=\r\n"
+      "Content-Length: " + boost::lexical_cast<std::string>(script.size()) +
+      "\r\n\r\n" + script;
+
+  double http_us = us_per_request([&]() {
+    for (int i = 0; i < kRequests; ++i) {
+      tcp::socket socket(client_io);
+      socket.connect(http_ep);
+      boost::asio::write(socket, boost::asio::buffer(http_request));
+      boost::system::error_code ec;
+      boost::asio::streambuf response;
+      boost::asio::read(socket, response, ec);
+    }
+  });
+
+  tcp::socket socket(client_io);
+  socket.connect(binary_ep);
+  socket.set_option(tcp::no_delay(true));
+  boost::asio::write(socket, boost::asio::buffer(
+      bp::message(0, bp::AUTH, "admin:bench")));
+  read_response(socket);
+
+  double sequential_us = us_per_request([&]() {
+    for (int i = 0; i < kRequests; ++i) {
+      boost::asio::write(socket, boost::asio::buffer(
+          bp::message(i, bp::SCRIPT, script)));
+      read_response(socket);
+    }
+  });
+
+  double pipelined_us = us_per_request([&]() {
+    std::string batch;
+    for (int i = 0; i < kRequests; ++i) {
+      batch += bp::message(i, bp::SCRIPT, script);
+    }
+    boost::asio::write(socket, boost::asio::buffer(batch));
+    for (int i = 0; i < kRequests; ++i) {
+      read_response(socket);
+    }
+  });
+
+  socket.close();
+  io_service.stop();
+  server.join();
+
+  std::cout << kRequests << " requests\n"
+            << "  http:              " << http_us << " us/request\n"
+            << "  binary sequential: " << sequential_us << " us/request\n"
+            << "  binary pipelined:  " << pipelined_us << " us/request\n";
+}
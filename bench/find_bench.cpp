@@ -0,0 +1,66 @@
+// Compares a children() scan with db:find() on an indexed field.
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "dust/document.h"
+#include "dust/storage/mem_store.h"
+#include "dust-server/lua_connection.h"
+
+namespace {
+
+const int kUsers = 10000;
+const int kRuns = 20;
+
+double run_ms(dust_server::lua_connection& con, const std::string& script,
+              std::string& result) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kRuns; ++i) {
+    result = con.apply_script(script);
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count() / kRuns;
+}
+
+}  // namespace
+
+int main() {
+  auto store = std::make_shared<dust::mem_store>();
+  dust::document users(store, "users");
+  for (int i = 0; i < kUsers; ++i) {
+    users["user" + std::to_string(i)]["status"]
+        .assign(i % 100 == 0 ? "active" : "inactive");
+  }
+
+  dust_server::lua_connection con(store);
+  con.add_index("users/*/status");
+
+  std::string scan = R"(
+function run(db)
+  local count = 0
+  local children = db:get_document("users"):children()
+  for i = 0, #children - 1 do
+    if children[i]:get("status"):val() == "active" then
+      count = count + 1
+    end
+  end
+  return tostring(count)
+end
+)";
+
+  std::string find = R"(
+function run(db)
+  return tostring(#db:find("users", "status", "active"))
+end
+)";
+
+  std::string scan_result, find_result;
+  double scan_ms = run_ms(con, scan, scan_result);
+  double find_ms = run_ms(con, find, find_result);
+
+  std::cout << "users: " << kUsers << "\n"
+            << "scan: " << scan_ms << " ms/query (" << scan_result << ")\n"
+            << "find: " << find_ms << " ms/query (" << find_result << ")\n";
+}
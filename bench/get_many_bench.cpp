@@ -0,0 +1,142 @@
+// Compares the baseline of reading scattered paths one by one
+// (a get(..) chain and one :val() per path) with one db:get_many() call, on
+// mem_store and on a store with a fixed per-call delay (like a store behind a
+// network or disk). Reports time and store reads per run of both variants.
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "dust/storage/key_value_store.h"
+#include "dust/storage/mem_store.h"
+#include "dust-server/lua_connection.h"
+#include "dust-server/script_stats.h"
+
+namespace {
+
+const int kUsers = 50;
+const int kRuns = 200;
+const int kSlowRuns = 5;
+
+/// Store decorator adding a delay to every read.
+class slow_store : public dust::key_value_store {
+ public:
+  slow_store(std::shared_ptr<dust::key_value_store> store,
+             std::chrono::microseconds delay)
+      : store_(std::move(store)),
+        delay_(delay) {
+  }
+
+  virtual bool contains(const std::string& key) {
+    std::this_thread::sleep_for(delay_);
+    return store_->contains(key);
+  }
+
+  virtual std::string get(const std::string& key) {
+    std::this_thread::sleep_for(delay_);
+    return store_->get(key);
+  }
+
+  virtual void set(const std::string& key, const std::string& value) {
+    store_->set(key, value);
+  }
+
+  virtual void remove(const std::string& key) {
+    store_->remove(key);
+  }
+
+ private:
+  std::shared_ptr<dust::key_value_store> store_;
+  std::chrono::microseconds delay_;
+};
+
+template <typename F>
+double measure_ms(int runs, F f) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < runs; ++i) {
+    f();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+/// Lua list of the name and mail paths of all users (a third of them
+/// missing), in scrambled order.
+std::string path_list() {
+  std::string paths = "{";
+  for (int i = 0; i < kUsers; ++i) {
+    int user = (i * 37) % kUsers;
+    paths += "\"app/users/u" + std::to_string(user) + "/name\", ";
+    paths += "\"app/users/u" + std::to_string(user) + "/mail\", ";
+  }
+  return paths + "}";
+}
+
+void fill(dust_server::lua_connection& con) {
+  con.apply_script("function run(db)\n"
+      "  local users = db:get_document(\"app\").users\n"
+      "  for i = 0, " + std::to_string(kUsers - 1) + " do\n"
+      "    users[\"u\" .. i].name = \"user\" .. i\n"
+      "    if i % 3 ~= 0 then users[\"u\" .. i].mail = i .. \"@x\" end\n"
+      "  end\n"
+      "  return \"ok\"\n"
+      "end\n");
+}
+
+void run(const std::string& name, dust_server::lua_connection& con,
+         int runs) {
+  std::string loop = "function run(db)\n"
+      "  local paths = " + path_list() + "\n"
+      "  local n = 0\n"
+      "  for _, path in ipairs(paths) do\n"
+      "    local doc = db:get_document(\"app\")\n"
+      "    for segment in path:gmatch(\"[^/]+\") do\n"
+      "      if segment ~= \"app\" then doc = doc:get(segment) end\n"
+      "    end\n"
+      "    local ok, value = pcall(doc.val, doc)\n"
+      "    if ok then n = n + #value end\n"
+      "  end\n"
+      "  return tostring(n)\n"
+      "end\n";
+
+  std::string many = "function run(db)\n"
+      "  local n = 0\n"
+      "  for _, r in ipairs(db:get_many(" + path_list() + ")) do\n"
+      "    if r.exists then n = n + #r.value end\n"
+      "  end\n"
+      "  return tostring(n)\n"
+      "end\n";
+
+  dust_server::script_stats loop_stats, many_stats;
+  if (con.apply_script(loop, &loop_stats) !=
+      con.apply_script(many, &many_stats)) {
+    std::cerr << "results differ\n";
+  }
+
+  double loop_ms = measure_ms(runs, [&]() { con.apply_script(loop); });
+  double many_ms = measure_ms(runs, [&]() { con.apply_script(many); });
+
+  std::cout << name << ", " << runs << " runs x " << 2 * kUsers << " paths\n"
+            << "  baseline loop: " << loop_ms << " ms, "
+            << loop_stats.reads << " store reads per run\n"
+            << "  get_many:      " << many_ms << " ms, "
+            << many_stats.reads << " store reads per run\n"
+            << "  speedup:       " << loop_ms / many_ms << "x\n";
+}
+
+}  // namespace
+
+int main() {
+  auto mem = std::make_shared<dust::mem_store>();
+  dust_server::lua_connection mem_con(mem);
+  fill(mem_con);
+  run("mem_store", mem_con, kRuns);
+
+  auto slow = std::make_shared<slow_store>(std::make_shared<dust::mem_store>(),
+                                           std::chrono::microseconds(50));
+  dust_server::lua_connection slow_con(slow);
+  fill(slow_con);
+  run("slow store (50us per read)", slow_con, kSlowRuns);
+}
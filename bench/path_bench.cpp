@@ -0,0 +1,106 @@
+// Compares deep path traversal with dust::document (one full path string per
+// hop, as the Document binding used to do) against script_document path
+// handles, in C++ and from Lua (get() chain vs. field access). Every
+// traversal ends with val() so the store access of the leaf is measured too.
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "dust/document.h"
+#include "dust/storage/mem_store.h"
+#include "dust-server/lua_connection.h"
+#include "dust-server/script_document.h"
+
+namespace {
+
+const int kDepth = 16;
+const int kRuns = 100000;
+const int kScriptRuns = 200;
+
+template <typename F>
+double measure_ms(int runs, F f) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < runs; ++i) {
+    f();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+dust::document descend(dust::document doc,
+                       std::vector<std::string>::const_iterator begin,
+                       std::vector<std::string>::const_iterator end) {
+  return begin == end ? doc : descend(doc[*begin], begin + 1, end);
+}
+
+std::string lua_path(const std::string& prefix, const std::string& sep,
+                     const std::string& suffix) {
+  std::string path;
+  for (int i = 0; i < kDepth; ++i) {
+    path += prefix + "level" + std::to_string(i) + suffix + sep;
+  }
+  return path;
+}
+
+}  // namespace
+
+int main() {
+  auto store = std::make_shared<dust::mem_store>();
+  dust_server::lua_connection con(store);
+
+  std::vector<std::string> segments;
+  for (int i = 0; i < kDepth; ++i) {
+    segments.push_back("level" + std::to_string(i));
+  }
+  descend(dust::document(store, "bench"), segments.begin(), segments.end())
+      .assign("leaf");
+
+  std::size_t checksum = 0;
+  double dust_ms = measure_ms(kRuns, [&]() {
+    checksum += descend(dust::document(store, "bench"),
+                        segments.begin(), segments.end()).val().size();
+  });
+
+  double handle_ms = measure_ms(kRuns, [&]() {
+    dust_server::script_document doc(&con, "bench");
+    for (const auto& segment : segments) {
+      doc = doc.get(segment);
+    }
+    checksum += doc.val().size();
+  });
+
+  std::string get_chain = "function run(db)\n"
+      "  local doc = db:get_document(\"bench\")\n"
+      "  for i = 1, 1000 do\n"
+      "    local d = doc" + lua_path(":get(\"", "", "\")") + ":val()\n"
+      "  end\n"
+      "  return \"ok\"\n"
+      "end\n";
+
+  std::string field_chain = "function run(db)\n"
+      "  local doc = db:get_document(\"bench\")\n"
+      "  for i = 1, 1000 do\n"
+      "    local d = doc" + lua_path(".", "", "") + ":val()\n"
+      "  end\n"
+      "  return \"ok\"\n"
+      "end\n";
+
+  double get_ms = measure_ms(kScriptRuns, [&]() {
+    con.apply_script(get_chain);
+  });
+
+  double field_ms = measure_ms(kScriptRuns, [&]() {
+    con.apply_script(field_chain);
+  });
+
+  std::cout << "depth " << kDepth << ", " << kRuns << " traversals\n"
+            << "  dust::document:  " << dust_ms << " ms\n"
+            << "  script_document: " << handle_ms << " ms\n"
+            << "lua, " << kScriptRuns << " x 1000 traversals\n"
+            << "  doc:get(..) chain: " << get_ms << " ms\n"
+            << "  doc.a.b chain:     " << field_ms << " ms\n"
+            << "(checksum " << checksum << ")\n";
+}
@@ -0,0 +1,148 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#ifndef DUST_SERVER_ADMISSION_CONTROLLER_H_
+#define DUST_SERVER_ADMISSION_CONTROLLER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dust_server {
+
+/// Limits the number of concurrently executed scripts without ever blocking
+/// the caller.
+///
+/// Requests exceeding the concurrency limit wait in a bounded queue. The
+/// queue is ordered by weighted fair queuing: every client gets a share of
+/// the execution slots proportional to its weight, so one client flooding
+/// the server only delays itself. Queued jobs are started through the
+/// dispatch function when a slot frees up. Requests are rejected right away
+/// if the queue is full, and by expire() once they waited longer than the
+/// maximum waiting time.
+class admission_controller {
+ public:
+  /// A queued request: called with true once admitted (release() has to be
+  /// called when done) or with false if rejected.
+  typedef std::function<void (bool admitted)> job;
+
+  /// Runs the given function, e.g. by posting it to a thread pool.
+  typedef std::function<void (std::function<void ()>)> dispatcher;
+
+  /// \param max_running the maximum number of concurrently admitted requests
+  /// \param max_queued the maximum number of waiting requests
+  /// \param max_wait the maximum time a request waits for admission
+  /// \param dispatch used to start queued jobs (never called with a lock
+  ///                 held)
+  admission_controller(std::size_t max_running, std::size_t max_queued,
+                       std::chrono::milliseconds max_wait,
+                       dispatcher dispatch);
+
+  /// Sets the weight of the client (default 1.0).
+  void set_weight(const std::string& client, double weight);
+
+  /// Takes a free execution slot without queueing.
+  ///
+  /// \param client the client the request belongs to
+  /// \return true if admitted (release() has to be called when done)
+  bool try_acquire(const std::string& client);
+
+  /// Queues a request. Returns immediately: the job is dispatched with the
+  /// admission decision later (or right away if a slot is free or the queue
+  /// is full).
+  ///
+  /// \param client the client the request belongs to
+  /// \param j the job to dispatch
+  void submit(const std::string& client, job j);
+
+  /// Frees the execution slot of an admitted request and dispatches the
+  /// next queued one.
+  void release();
+
+  /// Rejects the queued requests that waited longer than the maximum
+  /// waiting time. Has to be called periodically: without it, waiters only
+  /// time out when a slot frees up.
+  void expire();
+
+  std::size_t running() const;
+  std::size_t queued() const;
+  std::uint64_t admitted() const;
+  std::uint64_t rejected() const;
+
+ private:
+  typedef std::chrono::steady_clock steady_clock;
+
+  struct ticket {
+    double finish;
+    std::uint64_t seq;
+
+    bool operator<(const ticket& o) const {
+      return finish < o.finish || (finish == o.finish && seq < o.seq);
+    }
+  };
+
+  struct waiting {
+    double start;
+    steady_clock::time_point deadline;
+    job j;
+  };
+
+  /// \return the virtual (start, finish) time of the client's next request
+  std::pair<double, double> schedule(const std::string& client);
+
+  /// Takes the jobs that waited too long from the queue (mutex_ held).
+  /// \param decided receives the rejected jobs
+  void take_expired(std::vector<std::pair<job, bool>>& decided);
+
+  /// Takes expired and admitted jobs from the queue (mutex_ held).
+  /// \param decided receives the jobs with their admission decision
+  void drain(std::vector<std::pair<job, bool>>& decided);
+
+  /// Runs the decided jobs through the dispatcher (mutex_ not held).
+  void dispatch(std::vector<std::pair<job, bool>>& decided);
+
+  const std::size_t max_running_;
+  const std::size_t max_queued_;
+  const std::chrono::milliseconds max_wait_;
+  const dispatcher dispatch_;
+
+  mutable std::mutex mutex_;
+  std::map<ticket, waiting> queue_;
+  std::map<std::string, double> weights_;
+  std::map<std::string, double> last_finish_;
+  double virtual_time_;
+  std::uint64_t next_seq_;
+  std::size_t running_;
+  std::uint64_t admitted_;
+  std::uint64_t rejected_;
+};
+
+/// Releases an admitted request when going out of scope.
+class admission_guard {
+ public:
+  explicit admission_guard(admission_controller* controller)
+      : controller_(controller) {
+  }
+
+  ~admission_guard() {
+    if (controller_ != nullptr) {
+      controller_->release();
+    }
+  }
+
+ private:
+  admission_guard(const admission_guard&);
+  admission_guard& operator=(const admission_guard&);
+
+  admission_controller* controller_;
+};
+
+}  // namespace dust_server
+
+#endif  // DUST_SERVER_ADMISSION_CONTROLLER_H_
@@ -0,0 +1,70 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#ifndef DUST_SERVER_BINARY_PROTOCOL_H_
+#define DUST_SERVER_BINARY_PROTOCOL_H_
+
+#include <cstdint>
+#include <string>
+
+namespace dust_server {
+
+/// Length prefixed binary framing shared by the binary script protocol and
+/// the replication stream.
+///
+/// Every frame starts with the payload length as 32 bit big endian integer.
+/// Script protocol payloads start with a 32 bit request id and a one byte
+/// type (requests) or status (responses) followed by the body:
+///
+///   [length:4][id:4][type/status:1][body:length-5]
+namespace binary_protocol {
+
+/// Size of the length prefix.
+const std::size_t kHeaderSize = 4;
+
+/// Size of id and type/status at the beginning of a script protocol payload.
+const std::size_t kMessageHeaderSize = 5;
+
+/// Largest accepted payload.
+const std::uint32_t kMaxPayloadSize = 16 * 1024 * 1024;
+
+/// Request types.
+enum request_type : std::uint8_t {
+  AUTH = 1,             ///< body: "username:password"
+  SCRIPT = 2,           ///< body: lua script
+  CACHEABLE_SCRIPT = 3  ///< body: deterministic read-only lua script
+};
+
+/// Response status codes.
+enum response_status : std::uint8_t {
+  OK = 0,
+  BAD_REQUEST = 1,
+  UNAUTHORIZED = 2,
+  OVERLOADED = 3  ///< rejected by admission control, retry later
+};
+
+/// Appends a 32 bit big endian integer to the buffer.
+void put_u32(std::string& buf, std::uint32_t value);
+
+/// Reads a 32 bit big endian integer from the given position.
+std::uint32_t get_u32(const char* buf);
+
+/// Appends a 64 bit big endian integer to the buffer.
+void put_u64(std::string& buf, std::uint64_t value);
+
+/// Reads a 64 bit big endian integer from the given position.
+std::uint64_t get_u64(const char* buf);
+
+/// \return the complete frame (length prefix and payload)
+std::string frame(const std::string& payload);
+
+/// \return the complete frame for a script protocol message
+std::string message(std::uint32_t id, std::uint8_t code,
+                    const std::string& body);
+
+}  // namespace binary_protocol
+
+}  // namespace dust_server
+
+#endif  // DUST_SERVER_BINARY_PROTOCOL_H_
@@ -0,0 +1,57 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#ifndef DUST_SERVER_BINARY_SERVICE_H_
+#define DUST_SERVER_BINARY_SERVICE_H_
+
+#include <memory>
+
+#include "boost/asio/io_service.hpp"
+
+#include "dust-server/options.h"
+#include "dust-server/script_executor.h"
+
+namespace dust_server {
+
+/// Listener for the length prefixed binary script protocol
+/// (see binary_protocol.h).
+///
+/// Connections are long lived: a client authenticates once with an AUTH
+/// request and can then send any number of SCRIPT requests without waiting
+/// for the responses. Every response carries the id of its request.
+///
+/// Requests of one connection are serialized: they are answered in the
+/// order they were sent, and a script starts only after the previous one
+/// finished. So a pipelined read sees the writes sent before it, but a
+/// request answered from the result cache still waits for the script ahead
+/// of it. Clients wanting parallelism open several connections.
+///
+/// Scripts go through the same script_executor as HTTP requests (result
+/// cache, admission control keyed on the authenticated user, stats and slow
+/// script log) and never run on the io thread.
+class binary_service {
+ public:
+  /// \param io_service the io_service to run the listener on
+  /// \param executor the executor to run scripts with
+  /// \param config provides host, users and options::binary_port()
+  binary_service(boost::asio::io_service* io_service,
+                 std::shared_ptr<script_executor> executor,
+                 const options& config);
+
+  /// Stops accepting connections. Open connections stay until closed.
+  ~binary_service();
+
+  /// \return the port the listener is bound to (useful with port "0")
+  unsigned short port() const;
+
+ private:
+  class session;
+  class listener;
+
+  std::shared_ptr<listener> listener_;
+};
+
+}  // namespace dust_server
+
+#endif  // DUST_SERVER_BINARY_SERVICE_H_
@@ -0,0 +1,74 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#ifndef DUST_SERVER_CACHED_STORE_H_
+#define DUST_SERVER_CACHED_STORE_H_
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "dust/storage/key_value_store.h"
+
+namespace dust_server {
+
+/// Key value store decorator keeping the most recently used values and
+/// existence results (including negative ones) in memory.
+///
+/// Writes through this instance update the cache, so it stays consistent as
+/// long as the underlying store is not modified by anyone else.
+class cached_store : public dust::key_value_store {
+ public:
+  /// \param store the store to cache
+  /// \param capacity the maximum number of cached keys
+  cached_store(std::shared_ptr<dust::key_value_store> store,
+               std::size_t capacity);
+
+  virtual bool contains(const std::string& key);
+  virtual std::string get(const std::string& key);
+  virtual void set(const std::string& key, const std::string& value);
+  virtual void remove(const std::string& key);
+
+  /// \return the number of lookups answered from the cache
+  std::size_t hits() const;
+
+  /// \return the number of lookups forwarded to the underlying store
+  std::size_t misses() const;
+
+  /// \return hits / (hits + misses) or 0 if there were no lookups
+  double hit_rate() const;
+
+  /// \return the number of cached keys
+  std::size_t size() const;
+
+ private:
+  struct entry {
+    std::string key;
+    bool exists;
+    bool has_value;
+    std::string value;
+  };
+
+  typedef std::list<entry> lru_list;
+
+  /// \return the cached entry for the key (marked as recently used)
+  ///         or nullptr if the key is not cached
+  entry* lookup(const std::string& key);
+
+  /// Inserts or replaces the entry for the given key.
+  void put(const std::string& key, bool exists, bool has_value,
+           const std::string& value);
+
+  std::shared_ptr<dust::key_value_store> store_;
+  std::size_t capacity_;
+  lru_list lru_;
+  std::unordered_map<std::string, lru_list::iterator> entries_;
+  std::size_t hits_;
+  std::size_t misses_;
+};
+
+}  // namespace dust_server
+
+#endif  // DUST_SERVER_CACHED_STORE_H_
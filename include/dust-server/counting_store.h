@@ -0,0 +1,40 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#ifndef DUST_SERVER_COUNTING_STORE_H_
+#define DUST_SERVER_COUNTING_STORE_H_
+
+#include <memory>
+#include <string>
+
+#include "dust/storage/key_value_store.h"
+
+#include "dust-server/script_stats.h"
+
+namespace dust_server {
+
+/// Key value store decorator counting operations and transferred bytes.
+class counting_store : public dust::key_value_store {
+ public:
+  explicit counting_store(std::shared_ptr<dust::key_value_store> store);
+
+  virtual bool contains(const std::string& key);
+  virtual std::string get(const std::string& key);
+  virtual void set(const std::string& key, const std::string& value);
+  virtual void remove(const std::string& key);
+
+  /// Resets all counters to zero.
+  void reset();
+
+  /// Adds the counters to the store fields of the given stats.
+  void add_to(script_stats& stats) const;
+
+ private:
+  std::shared_ptr<dust::key_value_store> store_;
+  script_stats counters_;
+};
+
+}  // namespace dust_server
+
+#endif  // DUST_SERVER_COUNTING_STORE_H_
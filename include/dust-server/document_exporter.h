@@ -0,0 +1,84 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#ifndef DUST_SERVER_DOCUMENT_EXPORTER_H_
+#define DUST_SERVER_DOCUMENT_EXPORTER_H_
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "dust/document.h"
+#include "dust/storage/key_value_store.h"
+
+namespace dust_server {
+
+/// Writes a document tree to a stream without building it as one string.
+///
+/// The tree is walked level by level using document::children(), so only the
+/// child lists along the current path are held in memory. That is the whole
+/// (sorted) child list of every level on the path: memory grows with the
+/// width of the widest level, not with the size of the tree.
+///
+/// The NDJSON format emits one line per leaf value
+/// ({"key":"a/b","value":"..."}) and can be paged: write() stops after
+/// `limit` lines and returns the key of the last line, which can be passed
+/// as `resume_after` to continue the export. Children are exported in key
+/// order. The exporter keeps its position between pages: resuming after the
+/// key returned by the previous write() continues the walk without listing
+/// any level again. Other keys are looked up level by level. The tree must
+/// not change between two pages written by the same exporter.
+///
+/// The JSON format can't be paged, so `limit` caps the number of values of
+/// a JSON export instead.
+class document_exporter {
+ public:
+  enum format { JSON, NDJSON };
+
+  /// \param store the store to read from
+  /// \param root the index of the root document to export
+  /// \param fmt the output format
+  document_exporter(std::shared_ptr<dust::key_value_store> store,
+                    std::string root, format fmt);
+
+  /// Writes the (remaining) export to the given stream.
+  ///
+  /// \param out the stream to write to
+  /// \param resume_after the key of the last entry of the previous page
+  ///                     (NDJSON only, empty to start at the beginning)
+  /// \param limit the maximum number of entries to write (0 for no limit)
+  /// \return the key to resume from or an empty string if the export is done
+  /// \throws std::length_error if a JSON export has more than `limit`
+  ///         values (the stream then holds a partial document)
+  std::string write(std::ostream& out, const std::string& resume_after = "",
+                    std::size_t limit = 0);
+
+  /// Writes the given string as quoted and escaped JSON string.
+  static void write_json_string(std::ostream& out, const std::string& s);
+
+ private:
+  /// A level of the NDJSON walk: the sorted children of a document.
+  struct level {
+    std::vector<dust::document> children;
+    std::size_t next;
+    std::string key;
+  };
+
+  /// Positions the walk right behind the given key.
+  void seek(const std::string& resume_after);
+
+  /// Adds the children of the document to the walk.
+  void push(dust::document& doc, std::string key);
+
+  std::shared_ptr<dust::key_value_store> store_;
+  std::string root_;
+  format format_;
+  std::vector<level> walk_;
+  std::string position_;
+};
+
+}  // namespace dust_server
+
+#endif  // DUST_SERVER_DOCUMENT_EXPORTER_H_
@@ -0,0 +1,50 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#ifndef DUST_SERVER_FRAME_READER_H_
+#define DUST_SERVER_FRAME_READER_H_
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "boost/asio/ip/tcp.hpp"
+
+#include "dust-server/binary_protocol.h"
+
+namespace dust_server {
+
+/// Reads length prefixed frames (see binary_protocol.h) from a socket.
+///
+/// The reader does not own the socket; its owner has to outlive pending
+/// reads (e.g. by binding a shared_ptr to itself into the handler).
+class frame_reader {
+ public:
+  /// Called with the payload of the frame (without length prefix). Frames
+  /// with a size outside the accepted range fail with
+  /// boost::asio::error::message_size.
+  typedef std::function<void (const boost::system::error_code&,
+                              const std::string&)> handler;
+
+  /// \param socket the socket to read from
+  /// \param min_size the smallest accepted payload size
+  /// \param max_size the largest accepted payload size
+  frame_reader(boost::asio::ip::tcp::socket& socket, std::uint32_t min_size,
+               std::uint32_t max_size);
+
+  /// Reads the next frame.
+  void async_read(handler h);
+
+ private:
+  boost::asio::ip::tcp::socket& socket_;
+  const std::uint32_t min_size_;
+  const std::uint32_t max_size_;
+  std::array<char, binary_protocol::kHeaderSize> header_;
+  std::string payload_;
+};
+
+}  // namespace dust_server
+
+#endif  // DUST_SERVER_FRAME_READER_H_
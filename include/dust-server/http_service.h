@@ -5,6 +5,8 @@
 #ifndef DUST_SERVER_DUST_SERVER_H_
 #define DUST_SERVER_DUST_SERVER_H_
 
+#include <cstdint>
+#include <map>
 #include <memory>
 #include <string>
 
@@ -15,8 +17,14 @@
 
 #include "dust/storage/key_value_store.h"
 
+#include "dust-server/binary_service.h"
+#include "dust-server/document_exporter.h"
 #include "dust-server/lua_connection.h"
 #include "dust-server/options.h"
+#include "dust-server/replication_follower.h"
+#include "dust-server/replication_publisher.h"
+#include "dust-server/script_executor.h"
+#include "dust-server/ttl_reaper.h"
 
 namespace http_server {
 class request;
@@ -33,17 +41,69 @@ class http_service {
                std::shared_ptr<dust::key_value_store> store,
                const options& config);
 
+  /// Creates the lua connection for the given store as configured
+  /// (cache in front of the store, secondary indexes).
+  static std::shared_ptr<lua_connection> make_connection(
+      std::shared_ptr<dust::key_value_store> store,
+      const options& config);
+
+  /// \return the lua connection scripts are executed with
+  std::shared_ptr<lua_connection> connection() const;
+
+  /// \return the executor running the scripts of all listeners
+  std::shared_ptr<script_executor> executor() const;
+
  private:
-  bool authorized(const std::string& auth) const;
+  /// \param auth the Authorization header value ("Basic <base64>")
+  /// \param username set to the authenticated user
+  /// \return whether the credentials are valid
+  bool authorized(const std::string& auth, std::string* username) const;
+  /// Scripts run on the executor threads. http_server's handlers are
+  /// synchronous, so the io thread waits for the admission decision and the
+  /// result: one HTTP request at a time competes with the binary
+  /// connections for execution slots.
   void handle_request(const http::server::request& request,
                       http::server::reply& reply);
 
+  /// Fills in the reply for a script response (called on the thread
+  /// completing the script).
+  void reply_script(http::server::reply& reply,
+                    const script_executor::response& res,
+                    bool send_stats) const;
+  void handle_export(const std::string& query, http::server::reply& reply);
+
+  /// Remembers the position of a paged export (io thread only).
+  /// \param key the root and the key the next page resumes after
+  /// \param exporter the exporter positioned behind that key
+  /// \param version the root version the page was written at
+  void keep_export_cursor(const std::string& key,
+                          std::shared_ptr<document_exporter> exporter,
+                          std::uint64_t version);
+  void handle_metrics(http::server::reply& reply);
+
+  /// Adds the X-Dust-Replication-Lag header (milliseconds, -1 if unknown)
+  /// if this service is a replication follower.
+  void add_replication_lag(http::server::reply& reply) const;
+
   boost::asio::io_service* io_service_;
+  std::shared_ptr<dust_server::lua_connection> lua_con_;
+  std::shared_ptr<script_executor> executor_;
   http::server::request_handler request_handler_;
   http::server::server http_server_;
-  dust_server::lua_connection lua_con_;
-  const std::string username_;
-  const std::string password_;
+  std::map<std::string, std::string> users_;
+
+  /// A paged export that can continue without seeking.
+  struct export_cursor {
+    std::shared_ptr<document_exporter> exporter;
+    std::uint64_t version;
+    std::uint64_t last_used;
+  };
+  std::map<std::string, export_cursor> export_cursors_;
+  std::uint64_t export_pages_;
+  std::unique_ptr<binary_service> binary_service_;
+  std::unique_ptr<replication_publisher> replication_publisher_;
+  std::unique_ptr<replication_follower> replication_follower_;
+  std::unique_ptr<ttl_reaper> ttl_reaper_;
 };
 
 }  // namespace dust_server
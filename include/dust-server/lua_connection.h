@@ -5,12 +5,26 @@
 #ifndef DUST_SERVER_LUA_CONNECTION_H_
 #define DUST_SERVER_LUA_CONNECTION_H_
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
 
 #include "dust/storage/key_value_store.h"
 #include "dust/document.h"
 
+#include "dust-server/counting_store.h"
 #include "dust-server/lua_state_wrapper.h"
+#include "dust-server/result_cache.h"
+#include "dust-server/script_document.h"
+#include "dust-server/script_stats.h"
+#include "dust-server/secondary_index.h"
+#include "dust-server/timer_wheel.h"
 
 namespace dust_server {
 
@@ -36,15 +50,199 @@ class lua_error : public std::exception {
 
 class lua_connection {
  public:
+  friend class script_document;
+
+  /// Longest accepted TTL (ten years): longer TTLs are shortened to it.
+  static const std::uint64_t kMaxTtlSeconds = 10ULL * 365 * 24 * 60 * 60;
+
+  /// Kinds of writes reported by script documents. REPLACE (remove the
+  /// document, then import the JSON value) only comes from apply_change().
+  enum change { SET, REMOVE, IMPORT, REPLACE };
+
+  /// Receives every committed write with its path, kind and value (the
+  /// assigned value for SET, the imported JSON for IMPORT and REPLACE, empty
+  /// for REMOVE).
+  /// Listeners are called with mutex() held.
+  typedef std::function<void (const std::vector<std::string>&, change,
+                              const std::string&)> change_listener;
+
   lua_connection(std::shared_ptr<dust::key_value_store> store);
-  std::string apply_script(const std::string& script);
+
+  /// Executes the script's run function.
+  ///
+  /// \param script the script to execute
+  /// \param stats filled with the resource usage of the script if not nullptr
+  /// \return the result of the run function or an error message
+  std::string apply_script(const std::string& script,
+                           script_stats* stats = nullptr);
+
+  /// Like apply_script, but stores the result in the result cache if the
+  /// script did not write. Only use this for deterministic scripts.
+  ///
+  /// \param script the script to execute
+  /// \param key the cache key (script and all arguments)
+  /// \param stats filled with the resource usage of the script if not nullptr
+  std::string apply_cacheable_script(const std::string& script,
+                                     const std::string& key,
+                                     script_stats* stats = nullptr);
+
+  /// Enables caching of read-only script results (0 disables the cache).
+  void enable_result_cache(std::size_t capacity);
+
+  /// Looks up a cached script result. Does not create a lua state.
+  ///
+  /// \param key the cache key passed to apply_cacheable_script
+  /// \param result set to the cached result on a hit
+  /// \return whether a result was found and no root it read was written since
+  bool cached_result(const std::string& key, std::string& result);
+
+  /// \return the result cache (nullptr if disabled), guarded by mutex()
+  const result_cache* get_result_cache() const;
+
+  /// Registers a listener for all writes.
+  /// \return the id to remove the listener with
+  std::size_t add_change_listener(change_listener listener);
+
+  /// Removes the listener with the given id.
+  void remove_change_listener(std::size_t id);
+
+  /// Applies a write that does not come from a script (e.g. replicated from
+  /// a primary). Indexes, versions and listeners are updated like for script
+  /// writes. Allowed on read-only connections.
+  void apply_change(const std::vector<std::string>& path, change c,
+                    const std::string& value);
+
+  /// Makes all script writes fail (used by replication followers).
+  void set_read_only(bool read_only);
+
+  /// \return whether script writes are rejected
+  bool read_only() const;
+
+  /// Sets the replication lag in milliseconds (-1 if unknown).
+  void set_replication_lag(std::int64_t lag);
+
+  /// \return the replication lag in milliseconds (-1 if unknown)
+  std::int64_t replication_lag() const;
+
+  /// Returns the current time in milliseconds (any fixed epoch).
+  typedef std::function<std::uint64_t ()> clock_fn;
+
+  /// Replaces the clock TTLs are measured with (default: the steady clock),
+  /// e.g. to test expiry without waiting. Has to be called before any TTL
+  /// is set.
+  void set_clock(clock_fn now);
+
+  /// Removes documents whose TTL passed (see script_document::set_ttl).
+  /// Until then, expired documents already read as nonexistent.
+  ///
+  /// \param max the maximum number of documents to remove
+  /// \return the number of due TTL entries processed (at most max)
+  std::size_t expire(std::size_t max);
+
+  /// \return the number of documents with a TTL, guarded by mutex()
+  std::size_t ttl_count() const;
+
+  /// \return the number of writes to the given root, guarded by mutex()
+  std::uint64_t version(const std::string& root) const;
+
+  /// \return the store scripts are executed on
+  std::shared_ptr<dust::key_value_store> store() const;
+
+  /// Serializes store access. It is held while a script's run function is
+  /// executed, so it has to be locked by everyone else accessing the store
+  /// while scripts may run on other threads.
+  std::mutex& mutex();
+
+  /// Declares a secondary index and builds it from the current store content.
+  /// The index is kept up to date for all writes done by scripts.
+  ///
+  /// \param pattern the index pattern, e.g. "users/*/status"
+  /// \throws std::invalid_argument if the pattern is malformed
+  void add_index(const std::string& pattern);
 
  private:
   void registerLuaDocument(const state_wrapper& L);
-  void do_string(const state_wrapper&, const std::string& script);
-  dust::document get_document(const std::string& index);
+  void do_string(const state_wrapper&, const std::string& script,
+                 script_stats& stats);
+  /// Lua: db:get_document("users/alice") (slashes separate path segments)
+  script_document get_document(const std::string& index);
+
+  /// Lua: db:find("users", "status", "active")
+  std::vector<script_document> find(const std::string& path,
+                                    const std::string& field,
+                                    const std::string& value);
+
+  /// Lua: db:find_range("users", "name", "a", "m")
+  /// Values are compared as strings ("10" < "9"): zero-pad numbers to a
+  /// fixed width to range over them.
+  std::vector<script_document> find_range(const std::string& path,
+                                          const std::string& field,
+                                          const std::string& from,
+                                          const std::string& to);
+
+  /// Lua: db:get_many({"users/alice/name", "users/bob/name"}) returns
+  /// {{exists = true, value = "Alice"}, {exists = false}} in argument order.
+  /// Composite documents exist but have no value. Saves the per-path Lua
+  /// calls; the store is still read once per distinct path.
+  int get_many(lua_State* L);
+
+  std::string run_script(const std::string& script,
+                         const std::string* cache_key,
+                         script_stats* stats);
+
+  /// Called by script documents when reading below the given root.
+  void read(const std::string& root);
+
+  /// Called by script documents before writing.
+  /// \throws lua_error if the connection is read-only
+  void check_writable() const;
+
+  /// Called by script documents after a successful write.
+  void changed(const std::vector<std::string>& path, change c,
+               const std::string& value = "");
+
+  /// Called by script documents: lets the document expire after the given
+  /// finite number of seconds (<= 0 removes the TTL, at most
+  /// kMaxTtlSeconds).
+  void set_ttl(const std::vector<std::string>& path, double seconds);
+
+  /// \return whether documents below the given root have a TTL
+  bool has_ttls(const std::string& root) const;
+
+  /// \return whether the document or one of its parents expired
+  bool expired(const script_document& doc) const;
+  bool expired(const std::vector<std::string>& path) const;
+
+  /// Removes an expired document at or above the given one, so writes don't
+  /// resurrect expired content.
+  void purge_expired(const script_document& doc);
+
+  const secondary_index& get_index(const std::vector<std::string>& base,
+                                   const std::string& field) const;
+  std::vector<script_document> to_documents(
+      const std::vector<std::string>& base,
+      const std::vector<std::string>& keys);
+  script_document document_at(const std::vector<std::string>& path);
+  dust::document resolve(const std::vector<std::string>& path);
+  void reindex(secondary_index& index, const std::string& key);
+  void rebuild(secondary_index& index);
 
   std::shared_ptr<dust::key_value_store> store_;
+  std::shared_ptr<counting_store> script_store_;
+  std::vector<secondary_index> indexes_;
+  std::mutex mutex_;
+  std::map<std::string, std::uint64_t> versions_;
+  std::set<std::string> read_roots_;
+  bool wrote_;
+  std::uint64_t documents_;
+  std::unique_ptr<result_cache> result_cache_;
+  std::map<std::size_t, change_listener> listeners_;
+  std::size_t next_listener_id_;
+  std::atomic<bool> read_only_;
+  std::atomic<std::int64_t> replication_lag_;
+  clock_fn clock_;
+  std::map<std::vector<std::string>, std::uint64_t> expiries_;
+  timer_wheel ttl_wheel_;
 };
 
 }  // namespace dust_server
@@ -5,6 +5,8 @@
 #ifndef LUA_STATE_WRAPPER_H_
 #define LUA_STATE_WRAPPER_H_
 
+#include <cstdio>
+
 #include <lua.h>
 #include <lualib.h>
 #include <lauxlib.h>
@@ -21,6 +23,16 @@ class state_wrapper {
       : state_(luaL_newstate()) {
   }
 
+  /// Creates a new lua_State using lua_newstate() with the given allocation
+  /// function. Like luaL_newstate(), a panic function printing the error
+  /// message is installed.
+  state_wrapper(lua_Alloc alloc, void* ud)
+      : state_(lua_newstate(alloc, ud)) {
+    if (state_ != nullptr) {
+      lua_atpanic(state_, &panic);
+    }
+  }
+
   /// Takes control of the provided state. Warning: Don't call lua_close on the
   /// provided state. This will be done by the destructor.
   explicit state_wrapper(lua_State* state)
@@ -40,6 +52,12 @@ class state_wrapper {
   }
 
  private:
+  static int panic(lua_State* state) {
+    std::fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n",
+                 lua_tostring(state, -1));
+    return 0;
+  }
+
   /// The managed state.
   lua_State* state_;
 };
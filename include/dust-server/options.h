@@ -2,11 +2,13 @@
 // Licensed under the MIT license
 // https://raw.github.com/makielski/botscript/master/COPYING
 
-#ifndef DUST_SERVER_SCRPT_DOCUMENT_H_
-#define DUST_SERVER_SCRPT_DOCUMENT_H_
+#ifndef DUST_SERVER_OPTIONS_H_
+#define DUST_SERVER_OPTIONS_H_
 
+#include <map>
 #include <string>
 #include <istream>
+#include <vector>
 
 
 namespace dust_server {
@@ -22,14 +24,74 @@ class options {
   std::string port() const;
   std::string password() const;
 
+  /// \return the additional users allowed to run scripts (name -> password);
+  ///         "admin" always authenticates with password()
+  std::map<std::string, std::string> clients() const;
+
+  /// \return the port of the binary protocol listener (empty = disabled)
+  std::string binary_port() const;
+
+  /// \return the port to publish the replication stream on (empty = off)
+  std::string replication_port() const;
+
+  /// \return the roots sent as snapshot to new replication followers
+  std::vector<std::string> replication_roots() const;
+
+  /// \return the host of the primary to follow (empty = not a follower)
+  std::string primary_host() const;
+
+  /// \return the replication port of the primary to follow
+  std::string primary_port() const;
+
+  /// \return the secondary index patterns ("users/*/status") to maintain
+  std::vector<std::string> indexes() const;
+
+  /// \return the number of keys to cache in front of the store (0 = off)
+  std::size_t cache_size() const;
+
+  /// \return the number of read-only script results to cache (0 = off)
+  std::size_t result_cache_size() const;
+
+  /// \return the maximum number of concurrently executed scripts
+  ///         (0 = no admission control)
+  std::size_t max_running() const;
+
+  /// \return the maximum number of scripts waiting for execution
+  std::size_t max_queued() const;
+
+  /// \return the maximum time in milliseconds a script waits for execution
+  std::size_t max_queue_wait() const;
+
+  /// \return the execution time in milliseconds above which scripts are
+  ///         written to the slow script log (0 = off)
+  std::size_t slow_script_threshold() const;
+
+  /// \return the fair queuing weights of authenticated clients
+  ///         (default weight is 1.0)
+  std::map<std::string, double> client_weights() const;
+
  protected:
   std::string host_;
   std::string port_;
   std::string password_;
+  std::map<std::string, std::string> clients_;
+  std::string binary_port_;
+  std::string replication_port_;
+  std::vector<std::string> replication_roots_;
+  std::string primary_host_;
+  std::string primary_port_;
+  std::vector<std::string> indexes_;
+  std::size_t cache_size_;
+  std::size_t result_cache_size_;
+  std::size_t max_running_;
+  std::size_t max_queued_;
+  std::size_t max_queue_wait_;
+  std::map<std::string, double> client_weights_;
+  std::size_t slow_script_threshold_;
 };
 
 std::ostream& operator<<(std::ostream& out, const options& options);
 
 }  // namespace dust_server
 
-#endif  // DUST_SERVER_SCRPT_DOCUMENT_H_
+#endif  // DUST_SERVER_OPTIONS_H_
@@ -0,0 +1,71 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#ifndef DUST_SERVER_REPLICATION_FOLLOWER_H_
+#define DUST_SERVER_REPLICATION_FOLLOWER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "boost/asio/deadline_timer.hpp"
+#include "boost/asio/io_service.hpp"
+#include "boost/asio/ip/tcp.hpp"
+
+#include "dust-server/frame_reader.h"
+#include "dust-server/lua_connection.h"
+#include "dust-server/options.h"
+
+namespace dust_server {
+
+/// Keeps a lua_connection in sync with the replication stream of a primary
+/// (see replication_publisher.h).
+///
+/// The connection is switched to read-only mode: scripts can read but every
+/// write fails. The replication lag is updated on every received record and
+/// can be read with lua_connection::replication_lag(). The follower
+/// reconnects (and receives a new snapshot) when the stream breaks.
+class replication_follower {
+ public:
+  /// \param io_service the io_service to connect on
+  /// \param lua_con the connection to apply the replicated writes to
+  /// \param config provides password, primary_host() and primary_port()
+  replication_follower(boost::asio::io_service* io_service,
+                       std::shared_ptr<lua_connection> lua_con,
+                       const options& config);
+
+  ~replication_follower();
+
+  /// \return whether the snapshot of the current stream was received
+  bool synchronized() const;
+
+  /// \return the sequence number of the last applied write
+  std::uint64_t applied_seq() const;
+
+  /// \return the number of connections established to the primary so far
+  std::uint64_t connections() const;
+
+ private:
+  void connect();
+  void reconnect();
+  void read_record();
+  void handle_record(const std::string& payload);
+
+  boost::asio::io_service* io_service_;
+  boost::asio::ip::tcp::socket socket_;
+  frame_reader reader_;
+  boost::asio::deadline_timer reconnect_timer_;
+  std::shared_ptr<lua_connection> lua_con_;
+  const std::string credentials_;
+  const std::string host_;
+  const std::string port_;
+  std::atomic<bool> synchronized_;
+  std::atomic<std::uint64_t> applied_seq_;
+  std::atomic<std::uint64_t> connections_;
+};
+
+}  // namespace dust_server
+
+#endif  // DUST_SERVER_REPLICATION_FOLLOWER_H_
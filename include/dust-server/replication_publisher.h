@@ -0,0 +1,77 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#ifndef DUST_SERVER_REPLICATION_PUBLISHER_H_
+#define DUST_SERVER_REPLICATION_PUBLISHER_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "boost/asio/deadline_timer.hpp"
+#include "boost/asio/io_service.hpp"
+#include "boost/asio/ip/tcp.hpp"
+
+#include "dust-server/lua_connection.h"
+#include "dust-server/options.h"
+
+namespace dust_server {
+
+/// Publishes all writes of a lua_connection to connected followers
+/// (see replication_record.h for the stream format).
+///
+/// Followers authenticate by sending "admin:password" as first frame. They
+/// then get a snapshot of options::replication_roots() and all later writes.
+/// Snapshot and follower registration happen under the connection's mutex,
+/// so no write is lost or sent twice. Followers stay registered (and keep
+/// receiving the stream on the same connection) until they disconnect or a
+/// write to them fails.
+class replication_publisher {
+ public:
+  /// \param io_service the io_service to accept and write on
+  /// \param lua_con the connection to publish the writes of
+  /// \param config provides host, password, replication_port() and
+  ///               replication_roots()
+  replication_publisher(boost::asio::io_service* io_service,
+                        std::shared_ptr<lua_connection> lua_con,
+                        const options& config);
+
+  ~replication_publisher();
+
+  /// \return the port the listener is bound to (useful with port "0")
+  unsigned short port() const;
+
+ private:
+  class follower_session;
+
+  void start_accept();
+  void start_heartbeat();
+
+  /// Sends the snapshot to an authenticated follower and registers it.
+  void add_follower(std::shared_ptr<follower_session> s);
+
+  /// Change listener: sends the write to all followers.
+  void publish(const std::vector<std::string>& path,
+               lua_connection::change c, const std::string& value);
+
+  /// Queues the frame on all followers (mutex of lua_con_ held).
+  void broadcast(std::string frame);
+
+  boost::asio::io_service* io_service_;
+  boost::asio::ip::tcp::acceptor acceptor_;
+  boost::asio::deadline_timer heartbeat_timer_;
+  std::shared_ptr<lua_connection> lua_con_;
+  const std::string credentials_;
+  std::vector<std::string> roots_;
+  std::size_t listener_id_;
+
+  // Guarded by the mutex of lua_con_.
+  std::uint64_t seq_;
+  std::vector<std::shared_ptr<follower_session>> followers_;
+};
+
+}  // namespace dust_server
+
+#endif  // DUST_SERVER_REPLICATION_PUBLISHER_H_
@@ -0,0 +1,52 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#ifndef DUST_SERVER_REPLICATION_RECORD_H_
+#define DUST_SERVER_REPLICATION_RECORD_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "dust-server/lua_connection.h"
+
+namespace dust_server {
+
+/// One frame of the replication stream from a primary to its followers.
+///
+/// After connecting, a follower receives the snapshot of all replicated
+/// roots as CHANGE records (one REPLACE, SET or REMOVE per root), then a
+/// SNAPSHOT_END record and from then on every committed write as CHANGE
+/// record. HEARTBEAT records carry the primary's latest sequence number
+/// while no writes happen.
+struct replication_record {
+  enum record_type : std::uint8_t {
+    CHANGE = 1,
+    SNAPSHOT_END = 2,
+    HEARTBEAT = 3
+  };
+
+  replication_record();
+
+  /// \return the record as complete frame (see binary_protocol.h)
+  std::string encode() const;
+
+  /// \param payload the frame payload (without length prefix)
+  /// \throws std::runtime_error if the payload is malformed
+  static replication_record decode(const std::string& payload);
+
+  /// \return the current time in milliseconds since the epoch
+  static std::uint64_t now_ms();
+
+  std::uint8_t type;
+  std::uint64_t seq;
+  std::uint64_t timestamp_ms;
+  lua_connection::change change;
+  std::vector<std::string> path;
+  std::string value;
+};
+
+}  // namespace dust_server
+
+#endif  // DUST_SERVER_REPLICATION_RECORD_H_
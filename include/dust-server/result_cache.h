@@ -0,0 +1,69 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#ifndef DUST_SERVER_RESULT_CACHE_H_
+#define DUST_SERVER_RESULT_CACHE_H_
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace dust_server {
+
+/// LRU cache for results of read-only scripts.
+///
+/// Every entry remembers the versions of the document roots the script read.
+/// An entry is only returned as long as all of these roots still have the
+/// same version, i.e. were not written since the script ran.
+class result_cache {
+ public:
+  /// (root, version) pairs a cached result depends on.
+  typedef std::vector<std::pair<std::string, std::uint64_t>> root_versions;
+
+  /// Returns the current version of a root.
+  typedef std::function<std::uint64_t (const std::string&)> version_fn;
+
+  /// \param capacity the maximum number of cached results
+  explicit result_cache(std::size_t capacity);
+
+  /// \param key the cache key (script and arguments)
+  /// \param version returns the current version of a root
+  /// \param result set to the cached result on a hit
+  /// \return whether a valid result was found
+  bool get(const std::string& key, const version_fn& version,
+           std::string& result);
+
+  /// Stores the result of a script run.
+  void put(const std::string& key, std::string result,
+           root_versions versions);
+
+  std::size_t hits() const;
+  std::size_t misses() const;
+  std::size_t size() const;
+
+ private:
+  struct entry {
+    std::string key;
+    std::string result;
+    root_versions versions;
+  };
+
+  typedef std::list<entry> lru_list;
+
+  void erase(std::unordered_map<std::string, lru_list::iterator>::iterator it);
+
+  std::size_t capacity_;
+  lru_list lru_;
+  std::unordered_map<std::string, lru_list::iterator> entries_;
+  std::size_t hits_;
+  std::size_t misses_;
+};
+
+}  // namespace dust_server
+
+#endif  // DUST_SERVER_RESULT_CACHE_H_
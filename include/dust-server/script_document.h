@@ -5,30 +5,79 @@
 #ifndef DUST_SERVER_SCRPT_DOCUMENT_H_
 #define DUST_SERVER_SCRPT_DOCUMENT_H_
 
-#include "dust/document.h"
-
-#include "lua.h"
-#include "lualib.h"
-#include "lauxlib.h"
+#include <memory>
+#include <string>
+#include <vector>
 
-#include "LuaBridge/LuaBridge.h"
+#include "dust/document.h"
 
 namespace dust_server {
 
-class script_document : public dust::document {
+class lua_connection;
+
+/// Lua facing document.
+///
+/// The path is stored as a handle to a node that only holds the last path
+/// segment and a pointer to the parent node. Stepping to a child therefore
+/// costs one small allocation regardless of the depth, and documents with a
+/// common prefix share its nodes. The underlying dust::document is created
+/// from the full path on first store access and cached in the node (no
+/// documents are created for the ancestors).
+///
+/// All writes are reported to the lua_connection the document belongs to.
+/// Documents with an expired TTL (or below one) read as nonexistent.
+class script_document {
  public:
-  script_document(
-      std::weak_ptr<dust::key_value_store> store,
-      std::string full_path);
+  /// Creates the root document with the given index.
+  ///
+  /// \param con the connection providing the store and receiving changes
+  /// \param index the index of the root document
+  script_document(lua_connection* con, std::string index);
+
+  /// \return the child document with the given index (no store access)
+  script_document get(const std::string& index) const;
+
+  std::vector<script_document> children();
+  std::string index() const;
+  std::string val();
+  bool exists();
+  bool is_composite();
+  std::string to_json();
+
+  void set(const std::string& val);
+  void remove();
+  void from_json(const std::string& json);
+
+  /// Lets the document expire after the given number of seconds. Writing
+  /// the document removes its TTL.
+  ///
+  /// \param seconds the time to live (<= 0 removes the TTL, longer TTLs
+  ///                than lua_connection::kMaxTtlSeconds are shortened)
+  /// \throws lua_error if the document doesn't exist or seconds is not a
+  ///                   finite number
+  void set_ttl(double seconds);
+
+  /// \return the path segments of this document (built on every call)
+  std::vector<std::string> path() const;
+
+  /// \return the first path segment (the index passed to get_document)
+  const std::string& root() const;
+
+ private:
+  struct path_node;
+
+  script_document(lua_connection* con, std::shared_ptr<path_node> node);
+
+  /// \return the dust document for this path (created once per node)
+  dust::document& doc() const;
 
-  script_document(
-      std::weak_ptr<dust::key_value_store> store,
-      std::string path,
-      std::string index);
+  void track_read() const;
 
-  script_document(dust::document&);
+  /// \throws lua_error if the document expired
+  void check_not_expired() const;
 
-  script_document index_op(script_document doc, luabridge::LuaRef key);
+  lua_connection* con_;
+  std::shared_ptr<path_node> node_;
 };
 
 }  // namespace dust_server
@@ -0,0 +1,94 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#ifndef DUST_SERVER_SCRIPT_EXECUTOR_H_
+#define DUST_SERVER_SCRIPT_EXECUTOR_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boost/asio/deadline_timer.hpp"
+#include "boost/asio/io_service.hpp"
+
+#include "dust-server/admission_controller.h"
+#include "dust-server/lua_connection.h"
+#include "dust-server/options.h"
+#include "dust-server/script_stats.h"
+
+namespace dust_server {
+
+/// Common execution path for scripts of all listeners: result cache lookup,
+/// admission control, execution with stats and the slow script log.
+///
+/// Scripts are executed on a pool of executor threads, never on the
+/// caller's (io) thread. Requests waiting for admission are timed out by a
+/// timer on the executor threads.
+class script_executor {
+ public:
+  /// Outcome of a script request.
+  enum status {
+    EXECUTED,  ///< the script was executed (result and stats are set)
+    CACHED,    ///< the result was taken from the result cache
+    REJECTED   ///< no execution slot available (overloaded)
+  };
+
+  struct response {
+    response() : state(EXECUTED) {}
+
+    status state;
+    std::string result;
+    script_stats stats;
+  };
+
+  /// Receives the outcome of a submitted script.
+  typedef std::function<void (const response&)> callback;
+
+  /// \param lua_con the connection to execute scripts with
+  /// \param config provides the admission control options and the
+  ///               slow script threshold
+  script_executor(std::shared_ptr<lua_connection> lua_con,
+                  const options& config);
+
+  /// Waits for the executor threads to finish the scripts started so far.
+  ~script_executor();
+
+  /// Executes the script on an executor thread. Waits in the admission
+  /// queue if no execution slot is free; returns immediately.
+  ///
+  /// \param client the authenticated client (fair queuing key)
+  /// \param script the script to execute
+  /// \param cache_key the result cache key (empty = don't cache)
+  /// \param done called with the outcome on an executor thread (for cache
+  ///             hits: directly on the calling thread)
+  void submit(const std::string& client, const std::string& script,
+              const std::string& cache_key, callback done);
+
+  /// \return the admission controller (nullptr if admission is disabled)
+  admission_controller* admission() const;
+
+ private:
+  /// Executes the script (execution slot already taken).
+  response execute(const std::string& script, const std::string& cache_key);
+
+  /// Times out waiting requests every expiry_tick_ms_ until destruction.
+  void start_expiry_timer();
+
+  std::shared_ptr<lua_connection> lua_con_;
+  boost::asio::io_service workers_;
+  std::unique_ptr<boost::asio::io_service::work> work_;
+  std::unique_ptr<admission_controller> admission_;
+  boost::asio::deadline_timer expiry_timer_;
+  const std::size_t expiry_tick_ms_;
+  std::atomic<bool> stopping_;
+  std::vector<std::thread> threads_;
+  const std::size_t slow_script_threshold_;
+};
+
+}  // namespace dust_server
+
+#endif  // DUST_SERVER_SCRIPT_EXECUTOR_H_
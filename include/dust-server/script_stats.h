@@ -0,0 +1,34 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#ifndef DUST_SERVER_SCRIPT_STATS_H_
+#define DUST_SERVER_SCRIPT_STATS_H_
+
+#include <cstdint>
+#include <string>
+
+namespace dust_server {
+
+/// Resource usage of one script execution.
+struct script_stats {
+  script_stats();
+
+  /// \return the stats formatted as "reads=1;writes=0;..."
+  std::string to_string() const;
+
+  std::uint64_t reads;
+  std::uint64_t writes;
+  std::uint64_t removes;
+  std::uint64_t bytes_read;
+  std::uint64_t bytes_written;
+  std::uint64_t documents;
+  std::size_t lua_memory_peak;
+  double compile_ms;
+  double lock_wait_ms;
+  double execute_ms;
+};
+
+}  // namespace dust_server
+
+#endif  // DUST_SERVER_SCRIPT_STATS_H_
@@ -0,0 +1,65 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#ifndef DUST_SERVER_SECONDARY_INDEX_H_
+#define DUST_SERVER_SECONDARY_INDEX_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace dust_server {
+
+/// In-memory index over one field of all children of a document.
+///
+/// The index declared as "users/*/status" maps the value of every
+/// users/<key>/status leaf to <key>. Values are kept in string order, so
+/// equality lookups and range scans are both logarithmic plus the result
+/// size. Ranges are lexicographic: "10" sorts before "9".
+class secondary_index {
+ public:
+  /// \param pattern the index pattern "<base path>/*/<field>"
+  /// \throws std::invalid_argument if the pattern is malformed
+  explicit secondary_index(const std::string& pattern);
+
+  /// \return the path segments of the indexed document
+  const std::vector<std::string>& base() const;
+
+  /// \return the name of the indexed field
+  const std::string& field() const;
+
+  /// \return whether this index is declared for the given base and field
+  bool covers(const std::vector<std::string>& base,
+              const std::string& field) const;
+
+  /// Sets the indexed value of the child with the given key.
+  void update(const std::string& key, const std::string& value);
+
+  /// Removes the child with the given key from the index.
+  void erase(const std::string& key);
+
+  /// Removes all entries.
+  void clear();
+
+  /// \return the keys of all children with the given value
+  std::vector<std::string> find(const std::string& value) const;
+
+  /// \return the keys of all children with a value in [from, to]
+  ///         (compared as strings)
+  std::vector<std::string> find_range(const std::string& from,
+                                      const std::string& to) const;
+
+  /// \return the number of indexed children
+  std::size_t size() const;
+
+ private:
+  std::vector<std::string> base_;
+  std::string field_;
+  std::map<std::string, std::string> values_;
+  std::multimap<std::string, std::string> keys_;
+};
+
+}  // namespace dust_server
+
+#endif  // DUST_SERVER_SECONDARY_INDEX_H_
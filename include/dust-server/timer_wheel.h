@@ -0,0 +1,72 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#ifndef DUST_SERVER_TIMER_WHEEL_H_
+#define DUST_SERVER_TIMER_WHEEL_H_
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace dust_server {
+
+/// Hierarchical timer wheel for document paths.
+///
+/// Four levels of 64 slots each cover 64^4 ticks. Scheduling and advancing
+/// by one tick are O(1) (entries move down one level at most three times),
+/// independent of the number of scheduled entries. Entries that are due are
+/// collected in a ready list and handed out in batches of bounded size.
+///
+/// Entries can't be cancelled: the owner keeps the authoritative deadline
+/// and ignores entries whose deadline doesn't match anymore.
+class timer_wheel {
+ public:
+  struct entry {
+    std::uint64_t deadline;
+    std::vector<std::string> path;
+  };
+
+  /// \param now the current tick
+  explicit timer_wheel(std::uint64_t now);
+
+  /// Schedules the path to become due at the given tick.
+  void schedule(std::uint64_t deadline, std::vector<std::string> path);
+
+  /// Advances the wheel to the given tick, moving due entries to the ready
+  /// list.
+  void advance(std::uint64_t now);
+
+  /// Takes up to `max` due entries from the ready list.
+  ///
+  /// \param max the maximum number of entries to take
+  /// \param out the entries are appended here
+  /// \return the number of entries taken
+  std::size_t pop_due(std::size_t max, std::vector<entry>& out);
+
+  /// \return the number of scheduled and due entries
+  std::size_t size() const;
+
+ private:
+  static const std::size_t kLevels = 4;
+  static const std::size_t kSlotBits = 6;
+  static const std::size_t kSlots = 1 << kSlotBits;
+
+  typedef std::vector<entry> slot;
+
+  void insert(entry e);
+
+  /// Re-schedules the entries of the current slot of the given level.
+  void cascade(std::size_t level);
+
+  std::uint64_t now_;
+  std::array<std::array<slot, kSlots>, kLevels> levels_;
+  std::deque<entry> ready_;
+  std::size_t size_;
+};
+
+}  // namespace dust_server
+
+#endif  // DUST_SERVER_TIMER_WHEEL_H_
@@ -0,0 +1,44 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#ifndef DUST_SERVER_TTL_REAPER_H_
+#define DUST_SERVER_TTL_REAPER_H_
+
+#include <cstddef>
+#include <memory>
+
+#include "boost/asio/deadline_timer.hpp"
+#include "boost/asio/io_service.hpp"
+
+#include "dust-server/lua_connection.h"
+
+namespace dust_server {
+
+/// Removes expired documents (see script_document::set_ttl) on a timer.
+///
+/// Every run removes at most `batch` documents, so scripts only wait for
+/// one small batch even if many documents expire at once. Runs follow each
+/// other immediately while there is a backlog.
+class ttl_reaper {
+ public:
+  /// \param io_service the io_service to run the timer on
+  /// \param lua_con the connection to expire documents of
+  /// \param tick_ms the time between two runs in milliseconds
+  /// \param batch the maximum number of documents removed per run
+  ttl_reaper(boost::asio::io_service* io_service,
+             std::shared_ptr<lua_connection> lua_con,
+             std::size_t tick_ms = 100, std::size_t batch = 256);
+
+ private:
+  void start_timer(std::size_t delay_ms);
+
+  boost::asio::deadline_timer timer_;
+  std::shared_ptr<lua_connection> lua_con_;
+  const std::size_t tick_ms_;
+  const std::size_t batch_;
+};
+
+}  // namespace dust_server
+
+#endif  // DUST_SERVER_TTL_REAPER_H_
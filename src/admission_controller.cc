@@ -0,0 +1,162 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#include "dust-server/admission_controller.h"
+
+#include <algorithm>
+
+namespace dust_server {
+
+admission_controller::admission_controller(std::size_t max_running,
+                                           std::size_t max_queued,
+                                           std::chrono::milliseconds max_wait,
+                                           dispatcher dispatch)
+    : max_running_(std::max<std::size_t>(max_running, 1)),
+      max_queued_(max_queued),
+      max_wait_(max_wait),
+      dispatch_(std::move(dispatch)),
+      virtual_time_(0.0),
+      next_seq_(0),
+      running_(0),
+      admitted_(0),
+      rejected_(0) {
+}
+
+void admission_controller::set_weight(const std::string& client,
+                                      double weight) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  weights_[client] = weight;
+}
+
+bool admission_controller::try_acquire(const std::string& client) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (running_ < max_running_ && queue_.empty()) {
+    virtual_time_ = schedule(client).first;
+    ++running_;
+    ++admitted_;
+    return true;
+  }
+  ++rejected_;
+  return false;
+}
+
+void admission_controller::submit(const std::string& client, job j) {
+  std::vector<std::pair<job, bool>> decided;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_ < max_running_ && queue_.empty()) {
+      // Fast path: free slot and nobody waiting.
+      virtual_time_ = schedule(client).first;
+      ++running_;
+      ++admitted_;
+      decided.emplace_back(std::move(j), true);
+    } else if (queue_.size() >= max_queued_) {
+      // Overloaded: reject immediately.
+      ++rejected_;
+      decided.emplace_back(std::move(j), false);
+    } else {
+      auto times = schedule(client);
+      ticket t = { times.second, next_seq_++ };
+      waiting w = { times.first, steady_clock::now() + max_wait_,
+                    std::move(j) };
+      queue_.insert(std::make_pair(t, std::move(w)));
+    }
+  }
+  dispatch(decided);
+}
+
+void admission_controller::release() {
+  std::vector<std::pair<job, bool>> decided;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --running_;
+    drain(decided);
+    if (running_ == 0 && queue_.empty()) {
+      last_finish_.clear();
+      virtual_time_ = 0.0;
+    }
+  }
+  dispatch(decided);
+}
+
+void admission_controller::expire() {
+  std::vector<std::pair<job, bool>> decided;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    take_expired(decided);
+  }
+  dispatch(decided);
+}
+
+void admission_controller::take_expired(
+    std::vector<std::pair<job, bool>>& decided) {
+  auto now = steady_clock::now();
+  for (auto it = queue_.begin(); it != queue_.end();) {
+    if (it->second.deadline < now) {
+      ++rejected_;
+      decided.emplace_back(std::move(it->second.j), false);
+      it = queue_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void admission_controller::drain(
+    std::vector<std::pair<job, bool>>& decided) {
+  // Reject everything that waited too long.
+  take_expired(decided);
+
+  // Admit in fair queuing order.
+  while (running_ < max_running_ && !queue_.empty()) {
+    auto head = queue_.begin();
+    virtual_time_ = std::max(virtual_time_, head->second.start);
+    ++running_;
+    ++admitted_;
+    decided.emplace_back(std::move(head->second.j), true);
+    queue_.erase(head);
+  }
+}
+
+void admission_controller::dispatch(
+    std::vector<std::pair<job, bool>>& decided) {
+  for (auto& d : decided) {
+    job j = std::move(d.first);
+    bool admitted = d.second;
+    dispatch_([j, admitted]() { j(admitted); });
+  }
+}
+
+std::size_t admission_controller::running() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return running_;
+}
+
+std::size_t admission_controller::queued() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return queue_.size();
+}
+
+std::uint64_t admission_controller::admitted() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return admitted_;
+}
+
+std::uint64_t admission_controller::rejected() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return rejected_;
+}
+
+std::pair<double, double> admission_controller::schedule(
+    const std::string& client) {
+  auto weight_it = weights_.find(client);
+  double weight = weight_it == weights_.end() ? 1.0 : weight_it->second;
+
+  double& last_finish = last_finish_[client];
+  double start = std::max(virtual_time_, last_finish);
+  last_finish = start + 1.0 / std::max(weight, 0.001);
+  return std::make_pair(start, last_finish);
+}
+
+}  // namespace dust_server
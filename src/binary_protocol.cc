@@ -0,0 +1,56 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#include "dust-server/binary_protocol.h"
+
+namespace dust_server {
+
+namespace binary_protocol {
+
+void put_u32(std::string& buf, std::uint32_t value) {
+  buf.push_back(static_cast<char>((value >> 24) & 0xFF));
+  buf.push_back(static_cast<char>((value >> 16) & 0xFF));
+  buf.push_back(static_cast<char>((value >> 8) & 0xFF));
+  buf.push_back(static_cast<char>(value & 0xFF));
+}
+
+std::uint32_t get_u32(const char* buf) {
+  auto b = reinterpret_cast<const unsigned char*>(buf);
+  return (static_cast<std::uint32_t>(b[0]) << 24) |
+         (static_cast<std::uint32_t>(b[1]) << 16) |
+         (static_cast<std::uint32_t>(b[2]) << 8) |
+         static_cast<std::uint32_t>(b[3]);
+}
+
+void put_u64(std::string& buf, std::uint64_t value) {
+  put_u32(buf, static_cast<std::uint32_t>(value >> 32));
+  put_u32(buf, static_cast<std::uint32_t>(value & 0xFFFFFFFF));
+}
+
+std::uint64_t get_u64(const char* buf) {
+  return (static_cast<std::uint64_t>(get_u32(buf)) << 32) | get_u32(buf + 4);
+}
+
+std::string frame(const std::string& payload) {
+  std::string buf;
+  buf.reserve(kHeaderSize + payload.size());
+  put_u32(buf, static_cast<std::uint32_t>(payload.size()));
+  buf.append(payload);
+  return buf;
+}
+
+std::string message(std::uint32_t id, std::uint8_t code,
+                    const std::string& body) {
+  std::string buf;
+  buf.reserve(kHeaderSize + kMessageHeaderSize + body.size());
+  put_u32(buf, static_cast<std::uint32_t>(kMessageHeaderSize + body.size()));
+  put_u32(buf, id);
+  buf.push_back(static_cast<char>(code));
+  buf.append(body);
+  return buf;
+}
+
+}  // namespace binary_protocol
+
+}  // namespace dust_server
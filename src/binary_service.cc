@@ -0,0 +1,271 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#include "dust-server/binary_service.h"
+
+#include <deque>
+
+#include "boost/asio.hpp"
+
+#include "dust-server/binary_protocol.h"
+#include "dust-server/frame_reader.h"
+
+using boost::asio::ip::tcp;
+
+namespace dust_server {
+
+namespace bp = binary_protocol;
+
+namespace {
+
+/// Maximum number of unanswered requests per connection. Reading pauses
+/// while that many are pending.
+const std::size_t kMaxPendingRequests = 64;
+
+/// Time to wait before accepting again after an accept error (e.g. out of
+/// file descriptors).
+const std::size_t kAcceptRetryMs = 100;
+
+}  // namespace
+
+/// One client connection. Requests are read continuously and answered in
+/// order: scripts of one connection are executed one after another, the
+/// requests behind them wait in the pending queue. Responses are queued
+/// while a write is in progress.
+class binary_service::session
+    : public std::enable_shared_from_this<binary_service::session> {
+ public:
+  session(boost::asio::io_service& io_service,
+          std::shared_ptr<script_executor> executor,
+          const std::map<std::string, std::string>& users)
+      : io_service_(io_service),
+        socket_(io_service),
+        reader_(socket_, bp::kMessageHeaderSize, bp::kMaxPayloadSize),
+        executor_(std::move(executor)),
+        users_(users),
+        authenticated_(false),
+        executing_(false),
+        reading_(false),
+        writing_(false) {
+  }
+
+  tcp::socket& socket() {
+    return socket_;
+  }
+
+  void start() {
+    read_request();
+  }
+
+ private:
+  struct request {
+    std::uint32_t id;
+    std::uint8_t type;
+    std::string body;
+  };
+
+  void read_request() {
+    reading_ = true;
+    auto self = shared_from_this();
+    reader_.async_read([this, self](const boost::system::error_code& ec,
+                                    const std::string& payload) {
+      if (ec == boost::asio::error::message_size) {
+        socket_.close();
+        return;
+      } else if (ec) {
+        return;
+      }
+      reading_ = false;
+      pending_.push_back({ bp::get_u32(payload.data()),
+                           static_cast<std::uint8_t>(payload[4]),
+                           payload.substr(bp::kMessageHeaderSize) });
+      handle_requests();
+    });
+  }
+
+  /// Answers the pending requests up to the next script, hands the script
+  /// to the executor and continues reading if there is room for more.
+  void handle_requests() {
+    while (!executing_ && !pending_.empty()) {
+      const request& req = pending_.front();
+      if (req.type == bp::AUTH) {
+        size_t split = req.body.find(':');
+        auto user = split == std::string::npos
+            ? users_.end() : users_.find(req.body.substr(0, split));
+        authenticated_ = user != users_.end()
+            && req.body.substr(split + 1) == user->second;
+        client_ = authenticated_ ? user->first : "";
+        send(bp::message(req.id, authenticated_ ? bp::OK : bp::UNAUTHORIZED,
+                         ""));
+      } else if (!authenticated_) {
+        send(bp::message(req.id, bp::UNAUTHORIZED, ""));
+      } else if (req.type == bp::SCRIPT || req.type == bp::CACHEABLE_SCRIPT) {
+        execute(req);
+        break;
+      } else {
+        send(bp::message(req.id, bp::BAD_REQUEST, "unknown request type"));
+      }
+      pending_.pop_front();
+    }
+    resume_reading();
+  }
+
+  void execute(const request& req) {
+    executing_ = true;
+    auto self = shared_from_this();
+    executor_->submit(client_, req.body,
+        req.type == bp::CACHEABLE_SCRIPT ? "binary\n" + req.body : "",
+        [this, self](const script_executor::response& res) {
+          // Back to the io thread.
+          io_service_.post([this, self, res]() {
+            send(bp::message(pending_.front().id,
+                             res.state == script_executor::REJECTED
+                                 ? bp::OVERLOADED : bp::OK,
+                             res.result));
+            pending_.pop_front();
+            executing_ = false;
+            handle_requests();
+          });
+        });
+  }
+
+  void resume_reading() {
+    if (!reading_ && pending_.size() < kMaxPendingRequests &&
+        socket_.is_open()) {
+      read_request();
+    }
+  }
+
+  void send(std::string frame) {
+    out_.push_back(std::move(frame));
+    if (!writing_) {
+      write_next();
+    }
+  }
+
+  void write_next() {
+    writing_ = true;
+    auto self = shared_from_this();
+    boost::asio::async_write(socket_, boost::asio::buffer(out_.front()),
+        [this, self](const boost::system::error_code& ec, std::size_t) {
+          out_.pop_front();
+          if (ec) {
+            out_.clear();
+            writing_ = false;
+            return;
+          }
+          if (out_.empty()) {
+            writing_ = false;
+          } else {
+            write_next();
+          }
+        });
+  }
+
+  boost::asio::io_service& io_service_;
+  tcp::socket socket_;
+  frame_reader reader_;
+  std::shared_ptr<script_executor> executor_;
+  const std::map<std::string, std::string> users_;
+  bool authenticated_;
+  std::string client_;
+  std::deque<request> pending_;
+  bool executing_;
+  bool reading_;
+  std::deque<std::string> out_;
+  bool writing_;
+};
+
+/// The accepting socket. Shared with its pending handlers, so they never
+/// outlive it.
+class binary_service::listener
+    : public std::enable_shared_from_this<binary_service::listener> {
+ public:
+  listener(boost::asio::io_service& io_service,
+           std::shared_ptr<script_executor> executor,
+           const options& config)
+      : io_service_(io_service),
+        acceptor_(io_service),
+        retry_timer_(io_service),
+        executor_(std::move(executor)),
+        users_(config.clients()) {
+    users_["admin"] = config.password();
+    tcp::resolver resolver(io_service_);
+    tcp::endpoint endpoint = *resolver.resolve(
+        tcp::resolver::query(config.host(), config.binary_port()));
+    acceptor_.open(endpoint.protocol());
+    acceptor_.set_option(tcp::acceptor::reuse_address(true));
+    acceptor_.bind(endpoint);
+    acceptor_.listen();
+  }
+
+  unsigned short port() const {
+    return acceptor_.local_endpoint().port();
+  }
+
+  void start_accept() {
+    auto self = shared_from_this();
+    auto s = std::make_shared<session>(io_service_, executor_, users_);
+    acceptor_.async_accept(s->socket(),
+        [this, self, s](const boost::system::error_code& ec) {
+          if (!acceptor_.is_open() ||
+              ec == boost::asio::error::operation_aborted) {
+            return;
+          }
+          if (!ec) {
+            s->socket().set_option(tcp::no_delay(true));
+            s->start();
+            start_accept();
+          } else if (ec == boost::asio::error::connection_aborted) {
+            // Only this connection failed.
+            start_accept();
+          } else {
+            // Accepting again right away would spin (e.g. on EMFILE).
+            retry_accept();
+          }
+        });
+  }
+
+  void stop() {
+    boost::system::error_code ignored;
+    acceptor_.close(ignored);
+    retry_timer_.cancel(ignored);
+  }
+
+ private:
+  void retry_accept() {
+    auto self = shared_from_this();
+    retry_timer_.expires_from_now(
+        boost::posix_time::milliseconds(kAcceptRetryMs));
+    retry_timer_.async_wait([this, self](const boost::system::error_code& ec) {
+      if (!ec && acceptor_.is_open()) {
+        start_accept();
+      }
+    });
+  }
+
+  boost::asio::io_service& io_service_;
+  tcp::acceptor acceptor_;
+  boost::asio::deadline_timer retry_timer_;
+  std::shared_ptr<script_executor> executor_;
+  std::map<std::string, std::string> users_;
+};
+
+binary_service::binary_service(boost::asio::io_service* io_service,
+                               std::shared_ptr<script_executor> executor,
+                               const options& config)
+    : listener_(std::make_shared<listener>(*io_service, std::move(executor),
+                                           config)) {
+  listener_->start_accept();
+}
+
+binary_service::~binary_service() {
+  listener_->stop();
+}
+
+unsigned short binary_service::port() const {
+  return listener_->port();
+}
+
+}  // namespace dust_server
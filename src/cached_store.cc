@@ -0,0 +1,103 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#include "dust-server/cached_store.h"
+
+namespace dust_server {
+
+cached_store::cached_store(std::shared_ptr<dust::key_value_store> store,
+                           std::size_t capacity)
+    : store_(std::move(store)),
+      capacity_(capacity),
+      hits_(0),
+      misses_(0) {
+}
+
+bool cached_store::contains(const std::string& key) {
+  entry* e = lookup(key);
+  if (e != nullptr) {
+    ++hits_;
+    return e->exists;
+  }
+
+  ++misses_;
+  bool exists = store_->contains(key);
+  put(key, exists, false, "");
+  return exists;
+}
+
+std::string cached_store::get(const std::string& key) {
+  entry* e = lookup(key);
+  if (e != nullptr && e->has_value) {
+    ++hits_;
+    return e->value;
+  }
+
+  // Missing keys are forwarded, so the store reports them as usual.
+  ++misses_;
+  std::string value = store_->get(key);
+  put(key, true, true, value);
+  return value;
+}
+
+void cached_store::set(const std::string& key, const std::string& value) {
+  store_->set(key, value);
+  put(key, true, true, value);
+}
+
+void cached_store::remove(const std::string& key) {
+  store_->remove(key);
+  put(key, false, false, "");
+}
+
+std::size_t cached_store::hits() const {
+  return hits_;
+}
+
+std::size_t cached_store::misses() const {
+  return misses_;
+}
+
+double cached_store::hit_rate() const {
+  std::size_t lookups = hits_ + misses_;
+  return lookups == 0 ? 0.0 : static_cast<double>(hits_) / lookups;
+}
+
+std::size_t cached_store::size() const {
+  return entries_.size();
+}
+
+cached_store::entry* cached_store::lookup(const std::string& key) {
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    return nullptr;
+  }
+  lru_.splice(lru_.begin(), lru_, it->second);
+  return &*it->second;
+}
+
+void cached_store::put(const std::string& key, bool exists, bool has_value,
+                       const std::string& value) {
+  if (capacity_ == 0) {
+    return;
+  }
+
+  entry* e = lookup(key);
+  if (e != nullptr) {
+    e->exists = exists;
+    e->has_value = has_value;
+    e->value = value;
+    return;
+  }
+
+  if (entries_.size() >= capacity_) {
+    entries_.erase(lru_.back().key);
+    lru_.pop_back();
+  }
+
+  lru_.push_front({ key, exists, has_value, value });
+  entries_[key] = lru_.begin();
+}
+
+}  // namespace dust_server
@@ -0,0 +1,48 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#include "dust-server/counting_store.h"
+
+namespace dust_server {
+
+counting_store::counting_store(std::shared_ptr<dust::key_value_store> store)
+    : store_(std::move(store)) {
+}
+
+bool counting_store::contains(const std::string& key) {
+  ++counters_.reads;
+  return store_->contains(key);
+}
+
+std::string counting_store::get(const std::string& key) {
+  ++counters_.reads;
+  std::string value = store_->get(key);
+  counters_.bytes_read += value.size();
+  return value;
+}
+
+void counting_store::set(const std::string& key, const std::string& value) {
+  ++counters_.writes;
+  counters_.bytes_written += key.size() + value.size();
+  store_->set(key, value);
+}
+
+void counting_store::remove(const std::string& key) {
+  ++counters_.removes;
+  store_->remove(key);
+}
+
+void counting_store::reset() {
+  counters_ = script_stats();
+}
+
+void counting_store::add_to(script_stats& stats) const {
+  stats.reads += counters_.reads;
+  stats.writes += counters_.writes;
+  stats.removes += counters_.removes;
+  stats.bytes_read += counters_.bytes_read;
+  stats.bytes_written += counters_.bytes_written;
+}
+
+}  // namespace dust_server
@@ -0,0 +1,214 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#include "dust-server/document_exporter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "boost/algorithm/string/split.hpp"
+#include "boost/algorithm/string/classification.hpp"
+
+#include "dust/document.h"
+
+namespace dust_server {
+
+namespace {
+
+/// \return the children of the document in key order (the store doesn't
+///         guarantee any order, but paging relies on it)
+std::vector<dust::document> sorted_children(dust::document& doc) {
+  std::vector<dust::document> children = doc.children();
+  std::vector<std::pair<std::string, std::size_t>> order;
+  order.reserve(children.size());
+  for (std::size_t i = 0; i < children.size(); ++i) {
+    order.emplace_back(children[i].index(), i);
+  }
+  std::sort(order.begin(), order.end());
+
+  std::vector<dust::document> sorted;
+  sorted.reserve(children.size());
+  for (const auto& entry : order) {
+    sorted.push_back(children[entry.second]);
+  }
+  return sorted;
+}
+
+/// Writes one NDJSON line.
+void write_line(std::ostream& out, const std::string& key,
+                const std::string& value) {
+  out << "{\"key\":";
+  document_exporter::write_json_string(out, key);
+  out << ",\"value\":";
+  document_exporter::write_json_string(out, value);
+  out << "}\n";
+}
+
+/// Writes the document as JSON.
+/// \param budget the number of leaf values still allowed to be written
+void write_json(std::ostream& out, dust::document& doc,
+                std::size_t& budget) {
+  if (!doc.is_composite()) {
+    if (budget == 0) {
+      throw std::length_error("export too large for JSON");
+    }
+    --budget;
+    document_exporter::write_json_string(out, doc.val());
+    return;
+  }
+
+  out << "{";
+  bool first = true;
+  for (auto& child : sorted_children(doc)) {
+    if (!first) {
+      out << ",";
+    }
+    first = false;
+    document_exporter::write_json_string(out, child.index());
+    out << ":";
+    write_json(out, child, budget);
+  }
+  out << "}";
+}
+
+}  // namespace
+
+document_exporter::document_exporter(
+    std::shared_ptr<dust::key_value_store> store,
+    std::string root, format fmt)
+    : store_(std::move(store)),
+      root_(std::move(root)),
+      format_(fmt) {
+}
+
+std::string document_exporter::write(std::ostream& out,
+                                     const std::string& resume_after,
+                                     std::size_t limit) {
+  dust::document root(store_, root_);
+
+  if (format_ == JSON) {
+    if (root.exists()) {
+      std::size_t budget = limit == 0 ? std::size_t(-1) : limit;
+      write_json(out, root, budget);
+    } else {
+      out << "{}";
+    }
+    return "";
+  }
+
+  if (!root.exists()) {
+    return "";
+  }
+
+  if (!root.is_composite()) {
+    if (resume_after.empty()) {
+      write_line(out, "", root.val());
+    }
+    return "";
+  }
+
+  // Continue the previous page or look up the resume key.
+  if (walk_.empty() || resume_after != position_) {
+    walk_.clear();
+    push(root, "");
+    seek(resume_after);
+  }
+
+  std::size_t written = 0;
+  while (!walk_.empty() && (limit == 0 || written < limit)) {
+    level& top = walk_.back();
+    if (top.next == top.children.size()) {
+      walk_.pop_back();
+      continue;
+    }
+
+    dust::document child = top.children[top.next++];
+    std::string index = child.index();
+    std::string key = top.key.empty() ? index : top.key + "/" + index;
+    if (child.is_composite()) {
+      push(child, key);
+    } else {
+      write_line(out, key, child.val());
+      position_ = key;
+      ++written;
+    }
+  }
+
+  if (walk_.empty()) {
+    position_.clear();
+    return "";
+  }
+  return position_;
+}
+
+void document_exporter::seek(const std::string& resume_after) {
+  if (resume_after.empty()) {
+    return;
+  }
+
+  std::vector<std::string> from;
+  boost::split(from, resume_after, boost::is_any_of("/"));
+  for (std::size_t depth = 0; depth < from.size(); ++depth) {
+    level& top = walk_.back();
+    auto it = std::lower_bound(top.children.begin(), top.children.end(),
+        from[depth], [](const dust::document& doc, const std::string& index) {
+          return doc.index() < index;
+        });
+    top.next = it - top.children.begin();
+    if (it == top.children.end() || it->index() != from[depth]) {
+      // The key is gone: continue with the next larger one.
+      return;
+    }
+
+    if (depth + 1 == from.size()) {
+      // This is the last entry of the previous page.
+      ++top.next;
+      return;
+    }
+    if (!it->is_composite()) {
+      // Became a value since the previous page: export it.
+      return;
+    }
+
+    // Continue below the entry.
+    ++top.next;
+    dust::document child = *it;
+    push(child, top.key.empty() ? from[depth] : top.key + "/" + from[depth]);
+  }
+}
+
+void document_exporter::push(dust::document& doc, std::string key) {
+  level l = { sorted_children(doc), 0, std::move(key) };
+  walk_.push_back(std::move(l));
+}
+
+void document_exporter::write_json_string(std::ostream& out,
+                                          const std::string& s) {
+  out << '"';
+  for (char c : s) {
+    switch (c) {
+      case '"':  out << "\\\""; break;
+      case '\\': out << "\\\\"; break;
+      case '\b': out << "\\b"; break;
+      case '\f': out << "\\f"; break;
+      case '\n': out << "\\n"; break;
+      case '\r': out << "\\r"; break;
+      case '\t': out << "\\t"; break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char buf[7];
+          std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+          out << buf;
+        } else {
+          out << c;
+        }
+    }
+  }
+  out << '"';
+}
+
+}  // namespace dust_server
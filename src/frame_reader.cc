@@ -0,0 +1,42 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#include "dust-server/frame_reader.h"
+
+#include "boost/asio.hpp"
+
+namespace dust_server {
+
+namespace bp = binary_protocol;
+
+frame_reader::frame_reader(boost::asio::ip::tcp::socket& socket,
+                           std::uint32_t min_size, std::uint32_t max_size)
+    : socket_(socket),
+      min_size_(min_size),
+      max_size_(max_size) {
+}
+
+void frame_reader::async_read(handler h) {
+  boost::asio::async_read(socket_, boost::asio::buffer(header_),
+      [this, h](const boost::system::error_code& ec, std::size_t) {
+        if (ec) {
+          h(ec, payload_);
+          return;
+        }
+
+        std::uint32_t size = bp::get_u32(header_.data());
+        if (size < min_size_ || size > max_size_) {
+          h(boost::asio::error::message_size, payload_);
+          return;
+        }
+        payload_.resize(size);
+        boost::asio::async_read(socket_, boost::asio::buffer(&payload_[0],
+                                                             size),
+            [this, h](const boost::system::error_code& ec, std::size_t) {
+              h(ec, payload_);
+            });
+      });
+}
+
+}  // namespace dust_server
@@ -2,13 +2,21 @@
 // Licensed under the MIT license
 // https://raw.github.com/makielski/botscript/master/COPYING
 
+#include <algorithm>
+#include <map>
 #include <memory>
+#include <sstream>
+#include <stdexcept>
 #include <functional>
+#include <future>
+#include <iostream>
 
 #include "dust/storage/key_value_store.h"
 
 #include "dust-server/http_service.h"
 #include "dust-server/base64_decode.h"
+#include "dust-server/cached_store.h"
+#include "dust-server/document_exporter.h"
 
 #include "boost/lexical_cast.hpp"
 #include "boost/asio/io_service.hpp"
@@ -22,19 +30,99 @@ namespace dust_server {
 using std::placeholders::_1;
 using std::placeholders::_2;
 
+namespace {
+
+/// Maximum number of NDJSON lines sent in one export reply.
+const std::size_t kMaxExportPage = 10000;
+
+/// Maximum number of paged exports whose position is kept between pages.
+const std::size_t kMaxExportCursors = 16;
+
+/// Splits a query string ("a=1&b=2") into its url-decoded parameters.
+std::map<std::string, std::string> parse_query(const std::string& query) {
+  std::map<std::string, std::string> params;
+  std::istringstream in(query);
+  std::string pair;
+  while (std::getline(in, pair, '&')) {
+    size_t split = pair.find('=');
+    std::string key, value;
+    http::server::url_decode(pair.substr(0, split), key);
+    if (split != std::string::npos) {
+      http::server::url_decode(pair.substr(split + 1), value);
+    }
+    params[key] = value;
+  }
+  return params;
+}
+
+/// Puts a cache in front of the store if configured.
+std::shared_ptr<dust::key_value_store> wrap_store(
+    std::shared_ptr<dust::key_value_store> store, const options& config) {
+  if (config.cache_size() == 0) {
+    return store;
+  }
+  return std::make_shared<cached_store>(store, config.cache_size());
+}
+
+void reply_text(http::server::reply& rep, const std::string& content) {
+  rep.content = content;
+  rep.status = http::server::reply::ok;
+  rep.headers.resize(2);
+  rep.headers[0].name = "Content-Length";
+  rep.headers[0].value = boost::lexical_cast<std::string>(rep.content.size());
+  rep.headers[1].name = "Content-Type";
+  rep.headers[1].value = "text/plain";
+}
+
+}  // namespace
+
 http_service::http_service(boost::asio::io_service* io_service,
                            std::shared_ptr<dust::key_value_store> store,
                            const options& config)
     : io_service_(io_service),
+      lua_con_(make_connection(store, config)),
+      executor_(std::make_shared<script_executor>(lua_con_, config)),
       request_handler_(std::bind(&http_service::handle_request, this, _1, _2)),
       http_server_(*io_service_, config.host(), config.port(),
                    request_handler_),
-      lua_con_(store),
-      username_("admin"),
-      password_(config.password()) {
+      users_(config.clients()),
+      export_pages_(0) {
+  users_["admin"] = config.password();
+  if (!config.binary_port().empty()) {
+    binary_service_.reset(new binary_service(io_service, executor_, config));
+  }
+  if (!config.replication_port().empty()) {
+    replication_publisher_.reset(
+        new replication_publisher(io_service, lua_con_, config));
+  }
+  if (!config.primary_host().empty()) {
+    replication_follower_.reset(
+        new replication_follower(io_service, lua_con_, config));
+  }
+  ttl_reaper_.reset(new ttl_reaper(io_service, lua_con_));
+}
+
+std::shared_ptr<lua_connection> http_service::make_connection(
+    std::shared_ptr<dust::key_value_store> store,
+    const options& config) {
+  auto lua_con = std::make_shared<lua_connection>(wrap_store(store, config));
+  for (const auto& index : config.indexes()) {
+    lua_con->add_index(index);
+  }
+  lua_con->enable_result_cache(config.result_cache_size());
+  return lua_con;
+}
+
+std::shared_ptr<lua_connection> http_service::connection() const {
+  return lua_con_;
+}
+
+std::shared_ptr<script_executor> http_service::executor() const {
+  return executor_;
 }
 
-bool http_service::authorized(const std::string& auth) const {
+bool http_service::authorized(const std::string& auth,
+                              std::string* username) const {
   // Decode base64.
   std::string credentials = decode_base64(auth.substr(6));
 
@@ -43,10 +131,11 @@ bool http_service::authorized(const std::string& auth) const {
   if (split == std::string::npos) {
     return false;
   }
-  std::string username = credentials.substr(0, split);
+  *username = credentials.substr(0, split);
   std::string password = credentials.substr(split + 1, std::string::npos);
 
-  return username == username_ && password == password_;
+  auto user = users_.find(*username);
+  return user != users_.end() && password == user->second;
 }
 
 void http_service::handle_request(const http::server::request& req,
@@ -56,12 +145,18 @@ void http_service::handle_request(const http::server::request& req,
   // Extract headers.
   bool urlencoded = false;
   std::string auth = "";
+  bool cacheable = false;
+  bool send_stats = false;
   for (const auto& h : req.headers) {
     if (h.name == "Content-Type" && h.value.find("urlencoded")
         != std::string::npos) {
       urlencoded = true;
     } else if (h.name == "Authorization") {
       auth = h.value;
+    } else if (h.name == "X-Dust-Cache") {
+      cacheable = h.value == "true";
+    } else if (h.name == "X-Dust-Stats") {
+      send_stats = h.value == "true";
     }
   }
 
@@ -73,11 +168,28 @@ void http_service::handle_request(const http::server::request& req,
   }
 
   // Invalid username/password. -> STOP
-  if (!authorized(auth)) {
+  // The authenticated user is the fair queuing key for admission control.
+  std::string client;
+  if (!authorized(auth, &client)) {
     rep.status = http::server::reply::unauthorized;
     return;
   }
 
+  // Export request: /export?root=<index>[&format=ndjson&after=<key>&limit=n]
+  size_t query_start = req.uri.find('?');
+  if (req.uri.substr(0, query_start) == "/export") {
+    handle_export(query_start == std::string::npos
+                      ? "" : req.uri.substr(query_start + 1),
+                  rep);
+    return;
+  }
+
+  // Metrics request.
+  if (req.uri == "/metrics") {
+    handle_metrics(rep);
+    return;
+  }
+
   // Decode content if required.
   std::string script;
   if (urlencoded) {
@@ -87,19 +199,175 @@ void http_service::handle_request(const http::server::request& req,
     script = req.content;
   }
 
-  // Execute script.
+  // Execute script on the executor threads, queued by admission control.
+  // http_server needs the reply when this handler returns, so wait for the
+  // completion handler to fill it in.
   std::cout << "script:\n'" << script << "'\n";
-  std::string result = lua_con_.apply_script(script);
-  std::cout << "result: '" << result << "'\n";
+  std::promise<void> answered;
+  executor_->submit(client, script, cacheable ? req.uri + "\n" + script : "",
+      [this, &rep, &answered, send_stats](
+          const script_executor::response& res) {
+        reply_script(rep, res, send_stats);
+        answered.set_value();
+      });
+  answered.get_future().wait();
+}
+
+void http_service::reply_script(http::server::reply& rep,
+                                const script_executor::response& res,
+                                bool send_stats) const {
+  if (res.state == script_executor::REJECTED) {
+    rep = http::server::reply::stock_reply(
+        http::server::reply::service_unavailable);
+    rep.headers.push_back({ "Retry-After", "1" });
+    return;
+  }
+  if (res.state == script_executor::EXECUTED) {
+    std::cout << "result: '" << res.result << "'\n";
+  }
 
   // Send result.
-  rep.content = result;
+  reply_text(rep, res.result);
+  add_replication_lag(rep);
+  if (send_stats) {
+    rep.headers.push_back({ "X-Dust-Stats",
+        res.state == script_executor::CACHED ? "cached"
+                                             : res.stats.to_string() });
+  }
+}
+
+void http_service::handle_export(const std::string& query,
+                                 http::server::reply& rep) {
+  auto params = parse_query(query);
+  if (params["root"].empty()) {
+    rep = http::server::reply::stock_reply(http::server::reply::bad_request);
+    return;
+  }
+
+  bool ndjson = params["format"] == "ndjson";
+  std::size_t limit = kMaxExportPage;
+  if (!params["limit"].empty()) {
+    try {
+      limit = std::min(boost::lexical_cast<std::size_t>(params["limit"]),
+                       kMaxExportPage);
+    } catch (const boost::bad_lexical_cast&) {
+      limit = 0;
+    }
+    // 0 would mean "no limit" to the exporter.
+    if (limit == 0) {
+      rep = http::server::reply::stock_reply(http::server::reply::bad_request);
+      return;
+    }
+  }
+
+  // Scripts can't change the tree while one page is being written.
+  std::lock_guard<std::mutex> lock(lua_con_->mutex());
+  const std::string& root = params["root"];
+  std::uint64_t version = lua_con_->version(root.substr(0, root.find('/')));
+
+  // Continue where the previous page stopped if the root wasn't written
+  // since, instead of listing every level on the path again.
+  std::shared_ptr<document_exporter> exporter;
+  auto cursor = export_cursors_.find(root + "\n" + params["after"]);
+  if (cursor != export_cursors_.end()) {
+    if (ndjson && !params["after"].empty() &&
+        cursor->second.version == version) {
+      exporter = cursor->second.exporter;
+    }
+    export_cursors_.erase(cursor);
+  }
+  if (!exporter) {
+    exporter = std::make_shared<document_exporter>(
+        lua_con_->store(), root,
+        ndjson ? document_exporter::NDJSON : document_exporter::JSON);
+  }
+
+  std::ostringstream out;
+  std::string next;
+  try {
+    next = exporter->write(out, params["after"], limit);
+  } catch (const std::length_error&) {
+    // JSON exports aren't paged: refuse them above the page size.
+    reply_text(rep, "export too large for JSON, use format=ndjson\n");
+    rep.status = http::server::reply::bad_request;
+    return;
+  }
+
+  rep.content = out.str();
   rep.status = http::server::reply::ok;
-  rep.headers.resize(2);
-  rep.headers[0].name = "Content-Length";
-  rep.headers[0].value = boost::lexical_cast<std::string>(rep.content.size());
-  rep.headers[1].name = "Content-Type";
-  rep.headers[1].value = "text/plain";
+  rep.headers.push_back({ "Content-Length",
+      boost::lexical_cast<std::string>(rep.content.size()) });
+  rep.headers.push_back({ "Content-Type",
+      ndjson ? "application/x-ndjson" : "application/json" });
+  if (!next.empty()) {
+    rep.headers.push_back({ "X-Dust-Next", next });
+    keep_export_cursor(root + "\n" + next, exporter, version);
+  }
+}
+
+void http_service::keep_export_cursor(
+    const std::string& key, std::shared_ptr<document_exporter> exporter,
+    std::uint64_t version) {
+  if (export_cursors_.size() >= kMaxExportCursors) {
+    // Drop the least recently used cursor.
+    auto oldest = export_cursors_.begin();
+    for (auto it = export_cursors_.begin(); it != export_cursors_.end();
+         ++it) {
+      if (it->second.last_used < oldest->second.last_used) {
+        oldest = it;
+      }
+    }
+    export_cursors_.erase(oldest);
+  }
+  export_cursor& cursor = export_cursors_[key];
+  cursor.exporter = std::move(exporter);
+  cursor.version = version;
+  cursor.last_used = ++export_pages_;
+}
+
+void http_service::add_replication_lag(http::server::reply& rep) const {
+  // Lets clients of a follower decide whether the data is fresh enough.
+  if (lua_con_->read_only()) {
+    rep.headers.push_back({ "X-Dust-Replication-Lag",
+        boost::lexical_cast<std::string>(lua_con_->replication_lag()) });
+  }
+}
+
+void http_service::handle_metrics(http::server::reply& rep) {
+  std::ostringstream out;
+  if (lua_con_->read_only()) {
+    out << "dust_replication_lag_ms " << lua_con_->replication_lag() << "\n";
+  }
+  const admission_controller* admission = executor_->admission();
+  if (admission != nullptr) {
+    out << "dust_admission_running " << admission->running() << "\n"
+        << "dust_admission_queued " << admission->queued() << "\n"
+        << "dust_admission_admitted_total " << admission->admitted() << "\n"
+        << "dust_admission_rejected_total " << admission->rejected() << "\n";
+  }
+
+  std::lock_guard<std::mutex> lock(lua_con_->mutex());
+  auto cache = std::dynamic_pointer_cast<cached_store>(lua_con_->store());
+  if (cache) {
+    out << "dust_cache_hits_total " << cache->hits() << "\n"
+        << "dust_cache_misses_total " << cache->misses() << "\n"
+        << "dust_cache_size " << cache->size() << "\n";
+  }
+
+  out << "dust_ttl_documents " << lua_con_->ttl_count() << "\n";
+
+  const result_cache* results = lua_con_->get_result_cache();
+  if (results != nullptr) {
+    out << "dust_result_cache_hits_total " << results->hits() << "\n"
+        << "dust_result_cache_misses_total " << results->misses() << "\n"
+        << "dust_result_cache_size " << results->size() << "\n";
+  }
+
+  rep.content = out.str();
+  rep.status = http::server::reply::ok;
+  rep.headers.push_back({ "Content-Length",
+      boost::lexical_cast<std::string>(rep.content.size()) });
+  rep.headers.push_back({ "Content-Type", "text/plain" });
 }
 
 }  // namespace dust_server
@@ -4,7 +4,13 @@
 
 #include "dust-server/lua_connection.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
 #include <cstring>
+#include <functional>
+#include <iterator>
 
 #include "lua.h"
 #include "lualib.h"
@@ -12,6 +18,9 @@
 
 #include "LuaBridge/LuaBridge.h"
 
+#include "boost/algorithm/string/split.hpp"
+#include "boost/algorithm/string/classification.hpp"
+
 #include "dust/document.h"
 
 #include "dust-server/lua_state_wrapper.h"
@@ -20,20 +29,328 @@ using namespace luabridge;
 
 namespace dust_server {
 
+namespace {
+
+typedef std::vector<std::string>::const_iterator segment_it;
+
+dust::document descend(dust::document doc, segment_it begin, segment_it end) {
+  return begin == end ? doc : descend(doc[*begin], std::next(begin), end);
+}
+
+typedef std::chrono::steady_clock steady_clock;
+
+double ms_since(steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+      steady_clock::now() - start).count();
+}
+
+/// Resolution of document TTLs in milliseconds.
+const std::uint64_t kTtlTickMs = 100;
+
+std::uint64_t steady_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      steady_clock::now().time_since_epoch()).count();
+}
+
+/// \return the first timer wheel tick at or after the given time
+std::uint64_t ttl_tick(std::uint64_t ms) {
+  return (ms + kTtlTickMs - 1) / kTtlTickMs;
+}
+
+/// Current and peak memory of one lua state.
+struct memory_usage {
+  std::size_t current;
+  std::size_t peak;
+};
+
+/// Lua allocation function keeping track of the memory usage.
+void* tracking_alloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+  auto usage = static_cast<memory_usage*>(ud);
+  if (ptr == nullptr) {
+    // osize encodes the object type for new allocations.
+    osize = 0;
+  }
+
+  if (nsize == 0) {
+    std::free(ptr);
+    usage->current -= osize;
+    return nullptr;
+  }
+
+  void* mem = std::realloc(ptr, nsize);
+  if (mem != nullptr) {
+    usage->current = usage->current - osize + nsize;
+    usage->peak = std::max(usage->peak, usage->current);
+  }
+  return mem;
+}
+
+/// Calls the given function when going out of scope.
+class scope_exit {
+ public:
+  explicit scope_exit(std::function<void ()> f)
+      : f_(std::move(f)) {
+  }
+
+  ~scope_exit() {
+    f_();
+  }
+
+ private:
+  std::function<void ()> f_;
+};
+
+bool is_path_key(lua_State* L, int index) {
+  int type = lua_type(L, index);
+  return type == LUA_TSTRING || type == LUA_TNUMBER;
+}
+
+/// __index of Document: methods first, then child documents (doc.a, doc[1]).
+int document_index(lua_State* L) {
+  lua_pushvalue(L, lua_upvalueindex(1));
+  lua_pushvalue(L, 1);
+  lua_pushvalue(L, 2);
+  lua_call(L, 2, 1);
+  if (!lua_isnil(L, -1) || !is_path_key(L, 2)) {
+    return 1;
+  }
+  lua_pop(L, 1);
+
+  script_document* doc = Stack<script_document*>::get(L, 1);
+  Stack<script_document>::push(L, doc->get(lua_tostring(L, 2)));
+  return 1;
+}
+
+/// Performs doc[key] = value. Pushes the error message on failure.
+bool assign_child(lua_State* L) {
+  if (!is_path_key(L, 2)) {
+    lua_pushstring(L, "invalid document key");
+    return false;
+  }
+
+  script_document* doc = Stack<script_document*>::get(L, 1);
+  try {
+    script_document child = doc->get(lua_tostring(L, 2));
+    if (lua_isnil(L, 3)) {
+      child.remove();
+    } else if (is_path_key(L, 3)) {
+      child.set(lua_tostring(L, 3));
+    } else {
+      lua_pushstring(L, "only strings, numbers and nil can be assigned");
+      return false;
+    }
+  } catch (const std::exception& e) {
+    lua_pushstring(L, e.what());
+    return false;
+  }
+  return true;
+}
+
+/// One requested path of db:get_many().
+struct lookup {
+  std::vector<std::string> path;
+  std::size_t index;
+};
+
+/// Result of one db:get_many() lookup.
+struct lookup_result {
+  bool exists;
+  bool has_value;
+  std::string value;
+};
+
+/// Reads all paths of the get_many() argument table. Every distinct path
+/// is read on its own (the store has no multi-key read): one val() per
+/// path, exists() only when val() fails. Sorting finds duplicate paths, so
+/// they are read once.
+std::vector<lookup_result> lookup_all(lua_connection* con,
+                                      std::vector<lookup> lookups) {
+  std::vector<lookup_result> results(lookups.size());
+  std::sort(lookups.begin(), lookups.end(),
+            [](const lookup& a, const lookup& b) { return a.path < b.path; });
+
+  const lookup* prev = nullptr;
+  for (const auto& l : lookups) {
+    if (prev != nullptr && prev->path == l.path) {
+      results[l.index] = results[prev->index];
+      continue;
+    }
+
+    script_document doc(con, l.path.front());
+    for (auto it = std::next(l.path.begin()); it != l.path.end(); ++it) {
+      doc = doc.get(*it);
+    }
+
+    // Missing, expired and composite documents fail val().
+    lookup_result& r = results[l.index];
+    try {
+      r.value = doc.val();
+      r.exists = r.has_value = true;
+    } catch (const std::exception&) {
+      r.exists = doc.exists();
+      r.has_value = false;
+    }
+    prev = &l;
+  }
+  return results;
+}
+
+/// Performs db:get_many(paths). Pushes the result table or the error message.
+bool push_many(lua_connection* con, lua_State* L) {
+  if (!lua_istable(L, 2)) {
+    lua_pushstring(L, "usage: get_many({paths})");
+    return false;
+  }
+
+  std::vector<lookup> lookups(lua_rawlen(L, 2));
+  for (std::size_t i = 0; i < lookups.size(); ++i) {
+    lua_rawgeti(L, 2, static_cast<int>(i + 1));
+    bool valid = is_path_key(L, -1);
+    if (valid) {
+      boost::split(lookups[i].path, std::string(lua_tostring(L, -1)),
+                   boost::is_any_of("/"));
+      lookups[i].index = i;
+    }
+    lua_pop(L, 1);
+    if (!valid) {
+      lua_pushstring(L, "get_many: paths have to be strings");
+      return false;
+    }
+  }
+
+  std::vector<lookup_result> results;
+  try {
+    results = lookup_all(con, std::move(lookups));
+  } catch (const std::exception& e) {
+    lua_pushstring(L, e.what());
+    return false;
+  }
+
+  lua_createtable(L, static_cast<int>(results.size()), 0);
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    lua_createtable(L, 0, 2);
+    lua_pushboolean(L, results[i].exists);
+    lua_setfield(L, -2, "exists");
+    if (results[i].has_value) {
+      lua_pushlstring(L, results[i].value.data(), results[i].value.size());
+      lua_setfield(L, -2, "value");
+    }
+    lua_rawseti(L, -2, static_cast<int>(i + 1));
+  }
+  return true;
+}
+
+/// Performs doc:set(value [, ttl]). Pushes the error message on failure.
+bool set_value(lua_State* L) {
+  if (!is_path_key(L, 2) || !(lua_isnoneornil(L, 3) || lua_isnumber(L, 3))) {
+    lua_pushstring(L, "usage: set(value [, ttl])");
+    return false;
+  }
+
+  // Reject invalid TTLs before the value is written.
+  if (lua_isnumber(L, 3) && !std::isfinite(lua_tonumber(L, 3))) {
+    lua_pushstring(L, "TTL must be a finite number of seconds");
+    return false;
+  }
+
+  script_document* doc = Stack<script_document*>::get(L, 1);
+  try {
+    doc->set(lua_tostring(L, 2));
+    if (!lua_isnoneornil(L, 3)) {
+      doc->set_ttl(lua_tonumber(L, 3));
+    }
+  } catch (const std::exception& e) {
+    lua_pushstring(L, e.what());
+    return false;
+  }
+  return true;
+}
+
+/// Document:set(value [, ttl]): the optional TTL is given in seconds.
+int document_set(lua_State* L) {
+  if (!set_value(L)) {
+    return ::lua_error(L);
+  }
+  return 0;
+}
+
+/// __newindex of Document: doc.a = "value" sets, doc.a = nil removes.
+int document_newindex(lua_State* L) {
+  if (!assign_child(L)) {
+    return ::lua_error(L);
+  }
+  return 0;
+}
+
+}  // namespace
+
 lua_connection::lua_connection(std::shared_ptr<dust::key_value_store> store)
-    : store_(store) {
+    : store_(store),
+      script_store_(std::make_shared<counting_store>(store)),
+      wrote_(false),
+      documents_(0),
+      next_listener_id_(0),
+      read_only_(false),
+      replication_lag_(-1),
+      clock_(steady_ms),
+      ttl_wheel_(clock_() / kTtlTickMs) {
 }
 
-std::string lua_connection::apply_script(const std::string& script) {
+std::string lua_connection::apply_script(const std::string& script,
+                                         script_stats* stats) {
+  return run_script(script, nullptr, stats);
+}
+
+std::string lua_connection::apply_cacheable_script(const std::string& script,
+                                                   const std::string& key,
+                                                   script_stats* stats) {
+  return run_script(script, result_cache_ ? &key : nullptr, stats);
+}
+
+void lua_connection::enable_result_cache(std::size_t capacity) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  result_cache_.reset(capacity == 0 ? nullptr : new result_cache(capacity));
+}
+
+bool lua_connection::cached_result(const std::string& key,
+                                   std::string& result) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!result_cache_) {
+    return false;
+  }
+  return result_cache_->get(key, [this](const std::string& root) {
+    return version(root);
+  }, result);
+}
+
+const result_cache* lua_connection::get_result_cache() const {
+  return result_cache_.get();
+}
+
+std::string lua_connection::run_script(const std::string& script,
+                                       const std::string* cache_key,
+                                       script_stats* stats) {
+  script_stats unused;
+  if (stats == nullptr) {
+    stats = &unused;
+  }
+  *stats = script_stats();
+
+  // Record the memory peak on every return path.
+  memory_usage memory = { 0, 0 };
+  scope_exit finish([&]() {
+    stats->lua_memory_peak = memory.peak;
+  });
+
   try {
     // Create and initialize lua state.
-    state_wrapper state;
+    state_wrapper state(&tracking_alloc, &memory);
     luaL_openlibs(state.get());
     registerLuaDocument(state);
 
     // Load script.
     try {
-      do_string(state, script);
+      do_string(state, script, *stats);
     } catch (const lua_error& error) {
       return error.what();
     }
@@ -47,19 +364,157 @@ std::string lua_connection::apply_script(const std::string& script) {
     }
 
     // Execute run method and pass 'this', to allow getting a document in lua.
-    auto result = lua_run(this);
-    return result.isString() ? result.tostring() : "error: non-string return";
+    auto wait_start = steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats->lock_wait_ms = ms_since(wait_start);
+    read_roots_.clear();
+    wrote_ = false;
+    documents_ = 0;
+    script_store_->reset();
+    scope_exit count([&]() {
+      script_store_->add_to(*stats);
+      stats->documents = documents_;
+    });
+
+    // Time the script itself only (no state setup or lock wait).
+    auto run_start = steady_clock::now();
+    auto result = [&]() -> LuaRef {
+      scope_exit timed([&]() { stats->execute_ms = ms_since(run_start); });
+      return lua_run(this);
+    }();
+    if (!result.isString()) {
+      return "error: non-string return";
+    }
+
+    // Remember results of read-only scripts.
+    std::string str = result.tostring();
+    // Expiring documents would turn cached results stale without a write.
+    bool expiring = std::any_of(read_roots_.begin(), read_roots_.end(),
+        [this](const std::string& root) { return has_ttls(root); });
+    if (cache_key != nullptr && !wrote_ && !expiring) {
+      result_cache::root_versions versions;
+      for (const auto& root : read_roots_) {
+        versions.emplace_back(root, version(root));
+      }
+      result_cache_->put(*cache_key, str, std::move(versions));
+    }
+    return str;
   } catch (const LuaException& e) {
     return std::string("error: ") + e.what();
   }
 }
 
+std::size_t lua_connection::add_change_listener(change_listener listener) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  listeners_[next_listener_id_] = std::move(listener);
+  return next_listener_id_++;
+}
+
+void lua_connection::remove_change_listener(std::size_t id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  listeners_.erase(id);
+}
+
+void lua_connection::apply_change(const std::vector<std::string>& path,
+                                  change c, const std::string& value) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  dust::document doc = resolve(path);
+  switch (c) {
+    case SET:
+      doc.assign(value);
+      break;
+    case REMOVE:
+      if (!doc.exists()) {
+        return;
+      }
+      doc.remove();
+      break;
+    case IMPORT:
+      doc.from_json(value);
+      break;
+    case REPLACE:
+      // One change under one lock: readers never see the document missing.
+      if (doc.exists()) {
+        doc.remove();
+      }
+      doc.from_json(value);
+      break;
+  }
+  changed(path, c, value);
+}
+
+void lua_connection::set_read_only(bool read_only) {
+  read_only_ = read_only;
+}
+
+bool lua_connection::read_only() const {
+  return read_only_;
+}
+
+void lua_connection::set_replication_lag(std::int64_t lag) {
+  replication_lag_ = lag;
+}
+
+std::int64_t lua_connection::replication_lag() const {
+  return replication_lag_;
+}
+
+void lua_connection::set_clock(clock_fn now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  clock_ = std::move(now);
+  ttl_wheel_ = timer_wheel(clock_() / kTtlTickMs);
+}
+
+std::size_t lua_connection::expire(std::size_t max) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::uint64_t now = clock_();
+  ttl_wheel_.advance(now / kTtlTickMs);
+
+  std::vector<timer_wheel::entry> due;
+  ttl_wheel_.pop_due(max, due);
+  for (const auto& e : due) {
+    auto it = expiries_.find(e.path);
+    if (it == expiries_.end()) {
+      // TTL removed or document written since.
+      continue;
+    } else if (it->second > now) {
+      // TTL extended since: wait for the new deadline.
+      ttl_wheel_.schedule(ttl_tick(it->second), e.path);
+      continue;
+    }
+
+    dust::document doc = resolve(e.path);
+    if (doc.exists()) {
+      doc.remove();
+      changed(e.path, REMOVE);
+    } else {
+      expiries_.erase(it);
+    }
+  }
+  return due.size();
+}
+
+std::size_t lua_connection::ttl_count() const {
+  return expiries_.size();
+}
+
+std::shared_ptr<dust::key_value_store> lua_connection::store() const {
+  return store_;
+}
+
+std::mutex& lua_connection::mutex() {
+  return mutex_;
+}
+
 void lua_connection::do_string(const state_wrapper& state_wrap,
-                               const std::string& script) {
+                               const std::string& script,
+                               script_stats& stats) {
   lua_State* state = state_wrap.get();
 
   // Load buffer to state.
+  auto compile_start = steady_clock::now();
   int ret = luaL_loadbuffer(state, script.c_str(), script.length(), "");
+  stats.compile_ms = ms_since(compile_start);
 
   // Check load error.
   if (LUA_OK != ret) {
@@ -113,35 +568,297 @@ void lua_connection::do_string(const state_wrapper& state_wrap,
 }
 
 void lua_connection::registerLuaDocument(const state_wrapper& L) {
-  typedef std::vector<dust::document> doc_vec;
+  typedef std::vector<script_document> doc_vec;
   doc_vec::reference (doc_vec::*at_member)(doc_vec::size_type) = &doc_vec::at;
 
   getGlobalNamespace(L.get())
     .beginClass<lua_connection>("DB")
       .addFunction("get_document", &lua_connection::get_document)
+      .addFunction("find", &lua_connection::find)
+      .addFunction("find_range", &lua_connection::find_range)
+      .addCFunction("get_many", &lua_connection::get_many)
     .endClass()
-    .beginClass<dust::document>("Document")
-      .addConstructor <void (*)(const dust::document)>()
-      .addFunction("__tostring", &dust::document::to_json)
-      .addFunction("get", &dust::document::operator[])
-      .addFunction("set", &dust::document::assign)
-      .addFunction("index", &dust::document::index)
-      .addFunction("val", &dust::document::val)
-      .addFunction("exists", &dust::document::exists)
-      .addFunction("remove", &dust::document::remove)
-      .addFunction("is_composite", &dust::document::is_composite)
-      .addFunction("children", &dust::document::children)
-      .addFunction("from_json", &dust::document::from_json)
+    .beginClass<script_document>("Document")
+      .addConstructor <void (*)(const script_document)>()
+      .addFunction("__tostring", &script_document::to_json)
+      .addFunction("get", &script_document::get)
+      .addFunction("set", &script_document::set)
+      .addFunction("set_ttl", &script_document::set_ttl)
+      .addFunction("index", &script_document::index)
+      .addFunction("val", &script_document::val)
+      .addFunction("exists", &script_document::exists)
+      .addFunction("remove", &script_document::remove)
+      .addFunction("is_composite", &script_document::is_composite)
+      .addFunction("children", &script_document::children)
+      .addFunction("from_json", &script_document::from_json)
     .endClass()
     .beginClass<doc_vec>("DocumentVector")
       .addConstructor <void (*)(void)>()
       .addFunction("__index", at_member)
       .addFunction("__len", &doc_vec::size)
     .endClass();
+
+  // Chain path access (doc.a.b, doc["a"]) behind LuaBridge's method lookup
+  // and replace set() to make its TTL argument optional.
+  lua_State* state = L.get();
+  Stack<script_document>::push(state, script_document(this, ""));
+  lua_getmetatable(state, -1);
+  lua_getfield(state, -1, "__index");
+  lua_pushcclosure(state, &document_index, 1);
+  lua_setfield(state, -2, "__index");
+  lua_pushcfunction(state, &document_newindex);
+  lua_setfield(state, -2, "__newindex");
+  lua_pushcfunction(state, &document_set);
+  lua_setfield(state, -2, "set");
+  lua_pop(state, 2);
 }
 
-dust::document lua_connection::get_document(const std::string& index) {
-  return dust::document(store_, index);
+script_document lua_connection::get_document(const std::string& index) {
+  // "users/alice" has the same path as get_document("users"):get("alice"),
+  // so indexes, cached result versions and TTLs see the same document.
+  std::vector<std::string> path;
+  boost::split(path, index, boost::is_any_of("/"));
+  return document_at(path);
+}
+
+void lua_connection::add_index(const std::string& pattern) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  indexes_.emplace_back(pattern);
+  rebuild(indexes_.back());
+}
+
+std::vector<script_document> lua_connection::find(const std::string& path,
+                                                  const std::string& field,
+                                                  const std::string& value) {
+  std::vector<std::string> base;
+  boost::split(base, path, boost::is_any_of("/"));
+  read(base.front());
+  return to_documents(base, get_index(base, field).find(value));
+}
+
+std::vector<script_document> lua_connection::find_range(
+    const std::string& path, const std::string& field,
+    const std::string& from, const std::string& to) {
+  std::vector<std::string> base;
+  boost::split(base, path, boost::is_any_of("/"));
+  read(base.front());
+  return to_documents(base, get_index(base, field).find_range(from, to));
+}
+
+int lua_connection::get_many(lua_State* L) {
+  if (!push_many(this, L)) {
+    return ::lua_error(L);
+  }
+  return 1;
+}
+
+void lua_connection::read(const std::string& root) {
+  read_roots_.insert(root);
+}
+
+std::uint64_t lua_connection::version(const std::string& root) const {
+  auto it = versions_.find(root);
+  return it == versions_.end() ? 0 : it->second;
+}
+
+void lua_connection::set_ttl(const std::vector<std::string>& path,
+                             double seconds) {
+  // Cached results must not outlive the document.
+  ++versions_[path.front()];
+
+  if (seconds <= 0) {
+    expiries_.erase(path);
+    return;
+  }
+
+  // Keeps the conversion below defined and the deadline from overflowing.
+  seconds = std::min(seconds, static_cast<double>(kMaxTtlSeconds));
+  std::uint64_t deadline = clock_()
+                           + static_cast<std::uint64_t>(seconds * 1000);
+  auto it = expiries_.find(path);
+  bool armed = it != expiries_.end() && it->second <= deadline;
+  expiries_[path] = deadline;
+
+  // A longer TTL is picked up when the pending wheel entry fires, so
+  // refreshing a TTL doesn't pile up wheel entries.
+  if (!armed) {
+    ttl_wheel_.schedule(ttl_tick(deadline), path);
+  }
+}
+
+bool lua_connection::has_ttls(const std::string& root) const {
+  auto it = expiries_.lower_bound(std::vector<std::string>(1, root));
+  return it != expiries_.end() && it->first.front() == root;
+}
+
+bool lua_connection::expired(const script_document& doc) const {
+  return !expiries_.empty() && has_ttls(doc.root()) && expired(doc.path());
+}
+
+bool lua_connection::expired(const std::vector<std::string>& path) const {
+  std::uint64_t now = clock_();
+  std::vector<std::string> prefix;
+  prefix.reserve(path.size());
+  for (const auto& segment : path) {
+    prefix.push_back(segment);
+    auto it = expiries_.find(prefix);
+    if (it != expiries_.end() && it->second <= now) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void lua_connection::purge_expired(const script_document& doc) {
+  if (expiries_.empty() || !has_ttls(doc.root())) {
+    return;
+  }
+
+  std::uint64_t now = clock_();
+  std::vector<std::string> path = doc.path();
+  std::vector<std::string> prefix;
+  for (const auto& segment : path) {
+    prefix.push_back(segment);
+    auto it = expiries_.find(prefix);
+    if (it != expiries_.end() && it->second <= now) {
+      dust::document expired_doc = resolve(prefix);
+      if (expired_doc.exists()) {
+        expired_doc.remove();
+      }
+      changed(prefix, REMOVE);
+      return;
+    }
+  }
+}
+
+void lua_connection::check_writable() const {
+  if (read_only_) {
+    throw lua_error("read-only replica");
+  }
+}
+
+void lua_connection::changed(const std::vector<std::string>& path, change c,
+                             const std::string& value) {
+  wrote_ = true;
+  ++versions_[path.front()];
+
+  // Written documents lose their TTL, replaced or removed children too.
+  auto ttl = expiries_.lower_bound(path);
+  while (ttl != expiries_.end() && ttl->first.size() >= path.size()
+         && std::equal(path.begin(), path.end(), ttl->first.begin())) {
+    ttl = expiries_.erase(ttl);
+  }
+
+  for (const auto& listener : listeners_) {
+    listener.second(path, c, value);
+  }
+
+  for (auto& index : indexes_) {
+    const auto& base = index.base();
+
+    // Write at or above the indexed document: everything may have changed.
+    if (path.size() <= base.size()) {
+      if (std::equal(path.begin(), path.end(), base.begin())) {
+        if (c == SET) {
+          index.clear();
+        } else {
+          rebuild(index);
+        }
+      }
+      continue;
+    }
+
+    // Write somewhere else.
+    if (!std::equal(base.begin(), base.end(), path.begin())) {
+      continue;
+    }
+
+    // Write to another field of one child of the indexed document.
+    if (path.size() > base.size() + 1 &&
+        path[base.size() + 1] != index.field()) {
+      continue;
+    }
+
+    // Write to one child itself, to its field or below the field.
+    const std::string& key = path[base.size()];
+    bool is_field = path.size() == base.size() + 2;
+    if (c == SET && is_field) {
+      index.update(key, value);
+    } else if (c == REMOVE && path.size() <= base.size() + 2) {
+      index.erase(key);
+    } else {
+      // The child was replaced or the field is (now) composite.
+      reindex(index, key);
+    }
+  }
+}
+
+const secondary_index& lua_connection::get_index(
+    const std::vector<std::string>& base, const std::string& field) const {
+  for (const auto& index : indexes_) {
+    if (index.covers(base, field)) {
+      return index;
+    }
+  }
+  throw lua_error("no index declared for this path and field");
+}
+
+std::vector<script_document> lua_connection::to_documents(
+    const std::vector<std::string>& base,
+    const std::vector<std::string>& keys) {
+  script_document parent = document_at(base);
+  std::vector<script_document> result;
+  result.reserve(keys.size());
+  for (const auto& key : keys) {
+    result.push_back(parent.get(key));
+  }
+  return result;
+}
+
+script_document lua_connection::document_at(
+    const std::vector<std::string>& path) {
+  script_document doc(this, path.front());
+  for (auto it = std::next(path.begin()); it != path.end(); ++it) {
+    doc = doc.get(*it);
+  }
+  return doc;
+}
+
+dust::document lua_connection::resolve(const std::vector<std::string>& path) {
+  return descend(dust::document(store_, path.front()),
+                 std::next(path.begin()), path.end());
+}
+
+void lua_connection::reindex(secondary_index& index, const std::string& key) {
+  std::vector<std::string> path = index.base();
+  path.push_back(key);
+  path.push_back(index.field());
+
+  dust::document field = resolve(path);
+  if (field.exists() && !field.is_composite()) {
+    index.update(key, field.val());
+  } else {
+    index.erase(key);
+  }
+}
+
+void lua_connection::rebuild(secondary_index& index) {
+  index.clear();
+
+  dust::document base = resolve(index.base());
+  if (!base.exists() || !base.is_composite()) {
+    return;
+  }
+
+  for (auto& child : base.children()) {
+    if (!child.is_composite()) {
+      continue;
+    }
+    dust::document field = child[index.field()];
+    if (field.exists() && !field.is_composite()) {
+      index.update(child.index(), field.val());
+    }
+  }
 }
 
 }  // namespace dust_server
@@ -9,7 +9,13 @@ namespace dust_server {
 options::options(std::string host, std::string port, std::string password)
     : host_(std::move(host)),
       port_(std::move(port)),
-      password_(std::move(password)){
+      password_(std::move(password)),
+      cache_size_(0),
+      result_cache_size_(0),
+      max_running_(0),
+      max_queued_(64),
+      max_queue_wait_(1000),
+      slow_script_threshold_(0) {
 }
 
 options::~options() {
@@ -27,6 +33,62 @@ std::string options::password() const {
   return password_;
 }
 
+std::map<std::string, std::string> options::clients() const {
+  return clients_;
+}
+
+std::string options::binary_port() const {
+  return binary_port_;
+}
+
+std::string options::replication_port() const {
+  return replication_port_;
+}
+
+std::vector<std::string> options::replication_roots() const {
+  return replication_roots_;
+}
+
+std::string options::primary_host() const {
+  return primary_host_;
+}
+
+std::string options::primary_port() const {
+  return primary_port_;
+}
+
+std::vector<std::string> options::indexes() const {
+  return indexes_;
+}
+
+std::size_t options::cache_size() const {
+  return cache_size_;
+}
+
+std::size_t options::result_cache_size() const {
+  return result_cache_size_;
+}
+
+std::size_t options::max_running() const {
+  return max_running_;
+}
+
+std::size_t options::max_queued() const {
+  return max_queued_;
+}
+
+std::size_t options::max_queue_wait() const {
+  return max_queue_wait_;
+}
+
+std::map<std::string, double> options::client_weights() const {
+  return client_weights_;
+}
+
+std::size_t options::slow_script_threshold() const {
+  return slow_script_threshold_;
+}
+
 std::ostream& operator<<(std::ostream& out, const options& options) {
   std::string pw_val = options.password_;
   if (pw_val.empty()) {
@@ -35,7 +97,36 @@ std::ostream& operator<<(std::ostream& out, const options& options) {
 
   out << "\n" << "  dust_server_host: " << options.host_ << "\n"
   << "  dust_server_port: " << options.port_ << "\n"
-  << "  dust_server_password: " << pw_val << "\n";
+  << "  dust_server_password: " << pw_val << "\n"
+  << "  dust_server_binary_port: " << options.binary_port_ << "\n"
+  << "  dust_server_cache_size: " << options.cache_size_ << "\n"
+  << "  dust_server_result_cache_size: " << options.result_cache_size_ << "\n";
+  for (const auto& client : options.clients_) {
+    out << "  dust_server_client: " << client.first << "\n";
+  }
+  if (options.slow_script_threshold_ != 0) {
+    out << "  dust_server_slow_script_threshold: "
+        << options.slow_script_threshold_ << "ms\n";
+  }
+  if (options.max_running_ != 0) {
+    out << "  dust_server_max_running: " << options.max_running_ << "\n"
+    << "  dust_server_max_queued: " << options.max_queued_ << "\n"
+    << "  dust_server_max_queue_wait: " << options.max_queue_wait_ << "ms\n";
+  }
+  if (!options.replication_port_.empty()) {
+    out << "  dust_server_replication_port: " << options.replication_port_
+        << "\n";
+    for (const auto& root : options.replication_roots_) {
+      out << "  dust_server_replication_root: " << root << "\n";
+    }
+  }
+  if (!options.primary_host_.empty()) {
+    out << "  dust_server_primary: " << options.primary_host_ << ":"
+        << options.primary_port_ << "\n";
+  }
+  for (const auto& index : options.indexes_) {
+    out << "  dust_server_index: " << index << "\n";
+  }
   return out;
 }
 
@@ -0,0 +1,171 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#include "dust-server/replication_follower.h"
+
+#include <iostream>
+
+#include "boost/asio.hpp"
+
+#include "dust-server/replication_record.h"
+
+using boost::asio::ip::tcp;
+
+namespace dust_server {
+
+namespace bp = binary_protocol;
+
+namespace {
+
+/// \return the milliseconds since the given primary timestamp (clock skew
+///         between primary and follower is not corrected)
+std::int64_t lag_since(std::uint64_t timestamp_ms) {
+  std::int64_t lag = static_cast<std::int64_t>(replication_record::now_ms())
+                     - static_cast<std::int64_t>(timestamp_ms);
+  return lag < 0 ? 0 : lag;
+}
+
+}  // namespace
+
+replication_follower::replication_follower(
+    boost::asio::io_service* io_service,
+    std::shared_ptr<lua_connection> lua_con,
+    const options& config)
+    : io_service_(io_service),
+      socket_(*io_service),
+      reader_(socket_, 1, bp::kMaxPayloadSize),
+      reconnect_timer_(*io_service),
+      lua_con_(std::move(lua_con)),
+      credentials_("admin:" + config.password()),
+      host_(config.primary_host()),
+      port_(config.primary_port()),
+      synchronized_(false),
+      applied_seq_(0),
+      connections_(0) {
+  lua_con_->set_read_only(true);
+  connect();
+}
+
+replication_follower::~replication_follower() {
+  boost::system::error_code ec;
+  socket_.close(ec);
+  reconnect_timer_.cancel(ec);
+}
+
+bool replication_follower::synchronized() const {
+  return synchronized_;
+}
+
+std::uint64_t replication_follower::applied_seq() const {
+  return applied_seq_;
+}
+
+std::uint64_t replication_follower::connections() const {
+  return connections_;
+}
+
+void replication_follower::connect() {
+  tcp::resolver resolver(*io_service_);
+  boost::system::error_code ec;
+  auto it = resolver.resolve(tcp::resolver::query(host_, port_), ec);
+  if (ec) {
+    reconnect();
+    return;
+  }
+
+  socket_.async_connect(*it, [this](const boost::system::error_code& ec) {
+    if (ec == boost::asio::error::operation_aborted) {
+      return;
+    } else if (ec) {
+      reconnect();
+      return;
+    }
+    socket_.set_option(tcp::no_delay(true));
+    ++connections_;
+
+    // Authenticate, then receive the snapshot and the stream.
+    auto frame = std::make_shared<std::string>(bp::frame(credentials_));
+    boost::asio::async_write(socket_, boost::asio::buffer(*frame),
+        [this, frame](const boost::system::error_code& ec, std::size_t) {
+          if (ec == boost::asio::error::operation_aborted) {
+            return;
+          } else if (ec) {
+            reconnect();
+            return;
+          }
+          read_record();
+        });
+  });
+}
+
+void replication_follower::reconnect() {
+  boost::system::error_code ignored;
+  socket_.close(ignored);
+  synchronized_ = false;
+  lua_con_->set_replication_lag(-1);
+
+  reconnect_timer_.expires_from_now(boost::posix_time::seconds(1));
+  reconnect_timer_.async_wait([this](const boost::system::error_code& ec) {
+    if (!ec) {
+      connect();
+    }
+  });
+}
+
+void replication_follower::read_record() {
+  reader_.async_read([this](const boost::system::error_code& ec,
+                            const std::string& payload) {
+    if (ec == boost::asio::error::operation_aborted) {
+      return;
+    } else if (ec) {
+      if (ec == boost::asio::error::message_size) {
+        std::clog << "replication: invalid frame size\n";
+      }
+      reconnect();
+      return;
+    }
+
+    try {
+      handle_record(payload);
+    } catch (const std::exception& e) {
+      std::clog << "replication: " << e.what() << "\n";
+      reconnect();
+      return;
+    }
+    read_record();
+  });
+}
+
+void replication_follower::handle_record(const std::string& payload) {
+  replication_record record = replication_record::decode(payload);
+
+  switch (record.type) {
+    case replication_record::CHANGE:
+      lua_con_->apply_change(record.path, record.change, record.value);
+      applied_seq_ = record.seq;
+      if (synchronized_) {
+        lua_con_->set_replication_lag(lag_since(record.timestamp_ms));
+      }
+      break;
+
+    case replication_record::SNAPSHOT_END:
+      applied_seq_ = record.seq;
+      synchronized_ = true;
+      lua_con_->set_replication_lag(0);
+      break;
+
+    case replication_record::HEARTBEAT:
+      // All writes up to the heartbeat are applied: we are as recent as
+      // the primary was when sending it.
+      if (synchronized_ && applied_seq_ >= record.seq) {
+        lua_con_->set_replication_lag(lag_since(record.timestamp_ms));
+      }
+      break;
+
+    default:
+      throw std::runtime_error("unknown replication record type");
+  }
+}
+
+}  // namespace dust_server
@@ -0,0 +1,260 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#include "dust-server/replication_publisher.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <functional>
+
+#include "boost/asio.hpp"
+
+#include "dust/document.h"
+
+#include "dust-server/frame_reader.h"
+#include "dust-server/replication_record.h"
+
+using boost::asio::ip::tcp;
+
+namespace dust_server {
+
+using std::placeholders::_1;
+using std::placeholders::_2;
+using std::placeholders::_3;
+
+/// Write-only connection to one follower.
+class replication_publisher::follower_session
+    : public std::enable_shared_from_this<follower_session> {
+ public:
+  explicit follower_session(boost::asio::io_service& io_service)
+      : socket_(io_service),
+        reader_(socket_, 0, kMaxCredentialsSize),
+        writing_(false),
+        closed_(false) {
+  }
+
+  /// Reads the follower's credentials frame.
+  /// \param handler called with the frame payload
+  void read_credentials(std::function<void (const std::string&)> handler) {
+    auto self = shared_from_this();
+    reader_.async_read([this, self, handler](
+        const boost::system::error_code& ec, const std::string& payload) {
+      if (ec == boost::asio::error::message_size) {
+        socket_.close();
+      } else if (!ec) {
+        handler(payload);
+      }
+    });
+  }
+
+  /// Keeps a read pending to notice when the follower disconnects (it
+  /// sends nothing after the credentials).
+  void watch_close() {
+    auto self = shared_from_this();
+    socket_.async_read_some(boost::asio::buffer(discard_),
+        [this, self](const boost::system::error_code& ec, std::size_t) {
+          if (ec) {
+            close();
+          } else {
+            watch_close();
+          }
+        });
+  }
+
+  void close() {
+    closed_ = true;
+    boost::system::error_code ignored;
+    socket_.close(ignored);
+  }
+
+  tcp::socket& socket() {
+    return socket_;
+  }
+
+  /// \return false once the connection failed (safe from any thread)
+  bool is_open() const {
+    return !closed_;
+  }
+
+  void send(std::string frame) {
+    if (closed_) {
+      return;
+    }
+    out_.push_back(std::move(frame));
+    if (!writing_) {
+      write_next();
+    }
+  }
+
+ private:
+  void write_next() {
+    writing_ = true;
+    auto self = shared_from_this();
+    boost::asio::async_write(socket_, boost::asio::buffer(out_.front()),
+        [this, self](const boost::system::error_code& ec, std::size_t) {
+          out_.pop_front();
+          if (ec) {
+            out_.clear();
+            writing_ = false;
+            close();
+            return;
+          }
+          if (out_.empty()) {
+            writing_ = false;
+          } else {
+            write_next();
+          }
+        });
+  }
+
+  static const std::uint32_t kMaxCredentialsSize = 1024;
+
+  tcp::socket socket_;
+  frame_reader reader_;
+  std::deque<std::string> out_;
+  bool writing_;
+  std::atomic<bool> closed_;
+  std::array<char, 64> discard_;
+};
+
+replication_publisher::replication_publisher(
+    boost::asio::io_service* io_service,
+    std::shared_ptr<lua_connection> lua_con,
+    const options& config)
+    : io_service_(io_service),
+      acceptor_(*io_service),
+      heartbeat_timer_(*io_service),
+      lua_con_(std::move(lua_con)),
+      credentials_("admin:" + config.password()),
+      roots_(config.replication_roots()),
+      seq_(0) {
+  tcp::resolver resolver(*io_service_);
+  tcp::endpoint endpoint = *resolver.resolve(
+      tcp::resolver::query(config.host(), config.replication_port()));
+  acceptor_.open(endpoint.protocol());
+  acceptor_.set_option(tcp::acceptor::reuse_address(true));
+  acceptor_.bind(endpoint);
+  acceptor_.listen();
+
+  listener_id_ = lua_con_->add_change_listener(
+      std::bind(&replication_publisher::publish, this, _1, _2, _3));
+
+  start_accept();
+  start_heartbeat();
+}
+
+replication_publisher::~replication_publisher() {
+  lua_con_->remove_change_listener(listener_id_);
+
+  std::lock_guard<std::mutex> lock(lua_con_->mutex());
+  for (const auto& follower : followers_) {
+    follower->close();
+  }
+}
+
+unsigned short replication_publisher::port() const {
+  return acceptor_.local_endpoint().port();
+}
+
+void replication_publisher::start_accept() {
+  auto s = std::make_shared<follower_session>(*io_service_);
+  acceptor_.async_accept(s->socket(),
+      [this, s](const boost::system::error_code& ec) {
+        if (!ec) {
+          s->socket().set_option(tcp::no_delay(true));
+          s->read_credentials([this, s](const std::string& credentials) {
+            if (credentials != credentials_) {
+              s->close();
+              return;
+            }
+            add_follower(s);
+            s->watch_close();
+          });
+        }
+        if (acceptor_.is_open()) {
+          start_accept();
+        }
+      });
+}
+
+void replication_publisher::add_follower(
+    std::shared_ptr<follower_session> s) {
+  // Snapshot and registration are atomic with respect to writes.
+  std::lock_guard<std::mutex> lock(lua_con_->mutex());
+  // Every root is sent as one change that replaces the follower's copy.
+  for (const auto& root : roots_) {
+    replication_record record;
+    record.seq = seq_;
+    record.timestamp_ms = replication_record::now_ms();
+    record.path = { root };
+
+    dust::document doc(lua_con_->store(), root);
+    if (!doc.exists()) {
+      record.change = lua_connection::REMOVE;
+    } else if (doc.is_composite()) {
+      record.change = lua_connection::REPLACE;
+      record.value = doc.to_json();
+    } else {
+      record.change = lua_connection::SET;
+      record.value = doc.val();
+    }
+    s->send(record.encode());
+  }
+
+  replication_record end;
+  end.type = replication_record::SNAPSHOT_END;
+  end.seq = seq_;
+  end.timestamp_ms = replication_record::now_ms();
+  s->send(end.encode());
+
+  followers_.push_back(s);
+}
+
+void replication_publisher::start_heartbeat() {
+  heartbeat_timer_.expires_from_now(boost::posix_time::seconds(1));
+  heartbeat_timer_.async_wait([this](const boost::system::error_code& ec) {
+    if (ec) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(lua_con_->mutex());
+    replication_record heartbeat;
+    heartbeat.type = replication_record::HEARTBEAT;
+    heartbeat.seq = seq_;
+    heartbeat.timestamp_ms = replication_record::now_ms();
+    broadcast(heartbeat.encode());
+
+    start_heartbeat();
+  });
+}
+
+void replication_publisher::publish(const std::vector<std::string>& path,
+                                    lua_connection::change c,
+                                    const std::string& value) {
+  replication_record record;
+  record.seq = ++seq_;
+  record.timestamp_ms = replication_record::now_ms();
+  record.change = c;
+  record.path = path;
+  record.value = value;
+  broadcast(record.encode());
+}
+
+void replication_publisher::broadcast(std::string frame) {
+  // Drop followers whose connection failed or was closed.
+  followers_.erase(std::remove_if(followers_.begin(), followers_.end(),
+      [](const std::shared_ptr<follower_session>& f) {
+        return !f->is_open();
+      }), followers_.end());
+
+  // Writes may happen on any worker thread: hand the frame to the
+  // io_service the follower connections belong to.
+  for (const auto& follower : followers_) {
+    io_service_->post([follower, frame]() { follower->send(frame); });
+  }
+}
+
+}  // namespace dust_server
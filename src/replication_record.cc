@@ -0,0 +1,122 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#include "dust-server/replication_record.h"
+
+#include <chrono>
+#include <stdexcept>
+
+#include "dust-server/binary_protocol.h"
+
+namespace dust_server {
+
+namespace bp = binary_protocol;
+
+namespace {
+
+void put_string(std::string& buf, const std::string& s) {
+  bp::put_u32(buf, static_cast<std::uint32_t>(s.size()));
+  buf.append(s);
+}
+
+/// Sequential reader with bounds checks.
+class reader {
+ public:
+  explicit reader(const std::string& buf)
+      : buf_(buf),
+        pos_(0) {
+  }
+
+  std::uint8_t u8() {
+    require(1);
+    return static_cast<std::uint8_t>(buf_[pos_++]);
+  }
+
+  std::uint32_t u32() {
+    require(4);
+    std::uint32_t value = bp::get_u32(buf_.data() + pos_);
+    pos_ += 4;
+    return value;
+  }
+
+  std::uint64_t u64() {
+    require(8);
+    std::uint64_t value = bp::get_u64(buf_.data() + pos_);
+    pos_ += 8;
+    return value;
+  }
+
+  std::string str() {
+    std::uint32_t size = u32();
+    require(size);
+    std::string s = buf_.substr(pos_, size);
+    pos_ += size;
+    return s;
+  }
+
+ private:
+  void require(std::size_t n) const {
+    if (buf_.size() - pos_ < n) {
+      throw std::runtime_error("truncated replication record");
+    }
+  }
+
+  const std::string& buf_;
+  std::size_t pos_;
+};
+
+}  // namespace
+
+replication_record::replication_record()
+    : type(CHANGE),
+      seq(0),
+      timestamp_ms(0),
+      change(lua_connection::SET) {
+}
+
+std::string replication_record::encode() const {
+  std::string payload;
+  payload.push_back(static_cast<char>(type));
+  bp::put_u64(payload, seq);
+  bp::put_u64(payload, timestamp_ms);
+  payload.push_back(static_cast<char>(change));
+  bp::put_u32(payload, static_cast<std::uint32_t>(path.size()));
+  for (const auto& segment : path) {
+    put_string(payload, segment);
+  }
+  put_string(payload, value);
+  return bp::frame(payload);
+}
+
+replication_record replication_record::decode(const std::string& payload) {
+  reader r(payload);
+  replication_record record;
+  record.type = r.u8();
+  record.seq = r.u64();
+  record.timestamp_ms = r.u64();
+
+  std::uint8_t c = r.u8();
+  if (c > lua_connection::REPLACE) {
+    throw std::runtime_error("invalid change type");
+  }
+  record.change = static_cast<lua_connection::change>(c);
+
+  std::uint32_t segments = r.u32();
+  for (std::uint32_t i = 0; i < segments; ++i) {
+    record.path.push_back(r.str());
+  }
+  record.value = r.str();
+
+  if (record.type == CHANGE && record.path.empty()) {
+    throw std::runtime_error("change without path");
+  }
+  return record;
+}
+
+std::uint64_t replication_record::now_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace dust_server
@@ -0,0 +1,72 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#include "dust-server/result_cache.h"
+
+namespace dust_server {
+
+result_cache::result_cache(std::size_t capacity)
+    : capacity_(capacity),
+      hits_(0),
+      misses_(0) {
+}
+
+bool result_cache::get(const std::string& key, const version_fn& version,
+                       std::string& result) {
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    ++misses_;
+    return false;
+  }
+
+  for (const auto& root : it->second->versions) {
+    if (version(root.first) != root.second) {
+      erase(it);
+      ++misses_;
+      return false;
+    }
+  }
+
+  lru_.splice(lru_.begin(), lru_, it->second);
+  result = it->second->result;
+  ++hits_;
+  return true;
+}
+
+void result_cache::put(const std::string& key, std::string result,
+                       root_versions versions) {
+  if (capacity_ == 0) {
+    return;
+  }
+
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    erase(it);
+  } else if (entries_.size() >= capacity_) {
+    erase(entries_.find(lru_.back().key));
+  }
+
+  lru_.push_front({ key, std::move(result), std::move(versions) });
+  entries_[key] = lru_.begin();
+}
+
+std::size_t result_cache::hits() const {
+  return hits_;
+}
+
+std::size_t result_cache::misses() const {
+  return misses_;
+}
+
+std::size_t result_cache::size() const {
+  return entries_.size();
+}
+
+void result_cache::erase(
+    std::unordered_map<std::string, lru_list::iterator>::iterator it) {
+  lru_.erase(it->second);
+  entries_.erase(it);
+}
+
+}  // namespace dust_server
@@ -4,30 +4,157 @@
 
 #include "dust-server/script_document.h"
 
+#include <algorithm>
+#include <cmath>
+
+#include "boost/algorithm/string/join.hpp"
+
 #include "dust/document.h"
 
-#include "LuaBridge/LuaBridge.h"
+#include "dust-server/lua_connection.h"
 
 namespace dust_server {
 
-script_document::script_document(std::weak_ptr<dust::key_value_store> store,
-                                 std::string full_path)
-    : dust::document(store, full_path) {
+struct script_document::path_node {
+  path_node(std::shared_ptr<path_node> p, std::string s)
+      : parent(std::move(p)),
+        segment(std::move(s)),
+        root(parent ? parent->root : &segment),
+        depth(parent ? parent->depth + 1 : 1) {
+  }
+
+  std::shared_ptr<path_node> parent;
+  std::string segment;
+  const std::string* root;
+  std::size_t depth;
+  std::unique_ptr<dust::document> doc;
+};
+
+script_document::script_document(lua_connection* con, std::string index)
+    : con_(con),
+      node_(std::make_shared<path_node>(nullptr, std::move(index))) {
+}
+
+script_document::script_document(lua_connection* con,
+                                 std::shared_ptr<path_node> node)
+    : con_(con),
+      node_(std::move(node)) {
+}
+
+script_document script_document::get(const std::string& index) const {
+  return script_document(con_, std::make_shared<path_node>(node_, index));
+}
+
+std::vector<script_document> script_document::children() {
+  track_read();
+  std::vector<script_document> result;
+  if (con_->expired(*this)) {
+    return result;
+  }
+
+  for (auto& child : doc().children()) {
+    auto node = std::make_shared<path_node>(node_, child.index());
+    node->doc.reset(new dust::document(child));
+    result.push_back(script_document(con_, std::move(node)));
+  }
+  if (con_->has_ttls(root())) {
+    result.erase(std::remove_if(result.begin(), result.end(),
+        [this](const script_document& child) {
+          return con_->expired(child.path());
+        }), result.end());
+  }
+  con_->documents_ += result.size();
+  return result;
+}
+
+std::string script_document::index() const {
+  return node_->segment;
+}
+
+std::string script_document::val() {
+  track_read();
+  check_not_expired();
+  return doc().val();
+}
+
+bool script_document::exists() {
+  track_read();
+  return !con_->expired(*this) && doc().exists();
+}
+
+bool script_document::is_composite() {
+  track_read();
+  return !con_->expired(*this) && doc().is_composite();
+}
+
+std::string script_document::to_json() {
+  track_read();
+  check_not_expired();
+  return doc().to_json();
+}
+
+void script_document::set(const std::string& val) {
+  con_->check_writable();
+  con_->purge_expired(*this);
+  doc().assign(val);
+  con_->changed(path(), lua_connection::SET, val);
+}
+
+void script_document::set_ttl(double seconds) {
+  con_->check_writable();
+  if (!std::isfinite(seconds)) {
+    throw lua_error("TTL must be a finite number of seconds");
+  }
+  if (!exists()) {
+    throw lua_error("Database value does not exist");
+  }
+  con_->set_ttl(path(), seconds);
+}
+
+void script_document::remove() {
+  con_->check_writable();
+  doc().remove();
+  con_->changed(path(), lua_connection::REMOVE);
+}
+
+void script_document::from_json(const std::string& json) {
+  con_->check_writable();
+  con_->purge_expired(*this);
+  doc().from_json(json);
+  con_->changed(path(), lua_connection::IMPORT, json);
+}
+
+std::vector<std::string> script_document::path() const {
+  std::vector<std::string> segments(node_->depth);
+  std::size_t i = node_->depth;
+  for (const path_node* n = node_.get(); n != nullptr; n = n->parent.get()) {
+    segments[--i] = n->segment;
+  }
+  return segments;
 }
 
-script_document::script_document(std::weak_ptr<dust::key_value_store> store,
-                                 std::string path,
-                                 std::string index)
-    : dust::document(store, path, index) {
+const std::string& script_document::root() const {
+  return *node_->root;
 }
 
-script_document::script_document(dust::document& doc)
-    : dust::document(doc) {
+dust::document& script_document::doc() const {
+  if (!node_->doc) {
+    // Only the leaf is materialized, not one document per ancestor.
+    node_->doc.reset(new dust::document(con_->script_store_,
+                                        boost::algorithm::join(path(), "/")));
+    ++con_->documents_;
+  }
+  return *node_->doc;
 }
 
-script_document script_document::index_op(script_document, luabridge::LuaRef key) {
-  dust::document doc = operator[](key);
-  return doc;
+void script_document::track_read() const {
+  con_->read(root());
 }
 
+void script_document::check_not_expired() const {
+  if (con_->expired(*this)) {
+    throw lua_error("Database value does not exist");
+  }
 }
+
+}  // namespace dust_server
@@ -0,0 +1,141 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#include "dust-server/script_executor.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+
+namespace dust_server {
+
+namespace {
+
+/// Maximum number of script characters written to the slow script log.
+const std::size_t kSlowLogScriptLength = 200;
+
+/// Upper bound for the interval of the admission queue expiry timer.
+const std::size_t kMaxExpiryTickMs = 100;
+
+/// 64 bit FNV-1a hash: identical for the same script across builds, runs
+/// and platforms, so slow log entries can be grouped.
+std::uint64_t script_hash(const std::string& script) {
+  std::uint64_t hash = 14695981039346656037ULL;
+  for (unsigned char c : script) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/// Writes one slow script log entry.
+void log_slow_script(const std::string& script, const script_stats& stats) {
+  std::string body = script.substr(0, kSlowLogScriptLength);
+  std::replace(body.begin(), body.end(), '\n', ' ');
+  std::clog << "slow script " << std::hex << script_hash(script)
+            << std::dec << " " << stats.to_string() << " '" << body
+            << (script.size() > kSlowLogScriptLength ? "...'" : "'") << "\n";
+}
+
+}  // namespace
+
+script_executor::script_executor(std::shared_ptr<lua_connection> lua_con,
+                                 const options& config)
+    : lua_con_(std::move(lua_con)),
+      work_(new boost::asio::io_service::work(workers_)),
+      expiry_timer_(workers_),
+      expiry_tick_ms_(std::min(std::max<std::size_t>(
+          config.max_queue_wait() / 10, 1), kMaxExpiryTickMs)),
+      stopping_(false),
+      slow_script_threshold_(config.slow_script_threshold()) {
+  if (config.max_running() != 0) {
+    // Queued jobs are started on the executor threads, not by the thread
+    // releasing the slot.
+    admission_.reset(new admission_controller(
+        config.max_running(), config.max_queued(),
+        std::chrono::milliseconds(config.max_queue_wait()),
+        [this](std::function<void ()> job) { workers_.post(job); }));
+    for (const auto& weight : config.client_weights()) {
+      admission_->set_weight(weight.first, weight.second);
+    }
+    start_expiry_timer();
+  }
+
+  std::size_t threads = std::max<std::size_t>(config.max_running(), 1);
+  for (std::size_t i = 0; i < threads; ++i) {
+    threads_.emplace_back([this]() { workers_.run(); });
+  }
+}
+
+script_executor::~script_executor() {
+  // The pending expiry wait keeps the threads busy for at most two ticks.
+  stopping_ = true;
+  work_.reset();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void script_executor::submit(const std::string& client,
+                             const std::string& script,
+                             const std::string& cache_key, callback done) {
+  response res;
+  if (!cache_key.empty() && lua_con_->cached_result(cache_key, res.result)) {
+    res.state = CACHED;
+    done(res);
+    return;
+  }
+
+  if (!admission_) {
+    workers_.post([this, script, cache_key, done]() {
+      done(execute(script, cache_key));
+    });
+    return;
+  }
+
+  admission_->submit(client, [this, script, cache_key, done](bool admitted) {
+    response res;
+    if (!admitted) {
+      res.state = REJECTED;
+    } else {
+      // Free the slot before handing out the result.
+      admission_guard guard(admission_.get());
+      res = execute(script, cache_key);
+    }
+    done(res);
+  });
+}
+
+admission_controller* script_executor::admission() const {
+  return admission_.get();
+}
+
+void script_executor::start_expiry_timer() {
+  expiry_timer_.expires_from_now(
+      boost::posix_time::milliseconds(expiry_tick_ms_));
+  expiry_timer_.async_wait([this](const boost::system::error_code& ec) {
+    if (ec || stopping_) {
+      return;
+    }
+    admission_->expire();
+    start_expiry_timer();
+  });
+}
+
+script_executor::response script_executor::execute(
+    const std::string& script, const std::string& cache_key) {
+  response res;
+  res.result = cache_key.empty()
+      ? lua_con_->apply_script(script, &res.stats)
+      : lua_con_->apply_cacheable_script(script, cache_key, &res.stats);
+
+  if (slow_script_threshold_ != 0 &&
+      res.stats.compile_ms + res.stats.execute_ms > slow_script_threshold_) {
+    log_slow_script(script, res.stats);
+  }
+  return res;
+}
+
+}  // namespace dust_server
@@ -0,0 +1,39 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#include "dust-server/script_stats.h"
+
+#include <sstream>
+
+namespace dust_server {
+
+script_stats::script_stats()
+    : reads(0),
+      writes(0),
+      removes(0),
+      bytes_read(0),
+      bytes_written(0),
+      documents(0),
+      lua_memory_peak(0),
+      compile_ms(0.0),
+      lock_wait_ms(0.0),
+      execute_ms(0.0) {
+}
+
+std::string script_stats::to_string() const {
+  std::ostringstream out;
+  out << "reads=" << reads
+      << ";writes=" << writes
+      << ";removes=" << removes
+      << ";bytes_read=" << bytes_read
+      << ";bytes_written=" << bytes_written
+      << ";documents=" << documents
+      << ";lua_memory_peak=" << lua_memory_peak
+      << ";compile_ms=" << compile_ms
+      << ";lock_wait_ms=" << lock_wait_ms
+      << ";execute_ms=" << execute_ms;
+  return out.str();
+}
+
+}  // namespace dust_server
@@ -0,0 +1,97 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#include "dust-server/secondary_index.h"
+
+#include <stdexcept>
+
+#include "boost/algorithm/string/split.hpp"
+#include "boost/algorithm/string/classification.hpp"
+
+namespace dust_server {
+
+secondary_index::secondary_index(const std::string& pattern) {
+  std::vector<std::string> segments;
+  boost::split(segments, pattern, boost::is_any_of("/"));
+
+  if (segments.size() < 3 || segments[segments.size() - 2] != "*") {
+    throw std::invalid_argument("invalid index pattern: " + pattern);
+  }
+
+  field_ = segments.back();
+  base_.assign(segments.begin(), segments.end() - 2);
+
+  base_.push_back(field_);
+  for (const auto& segment : base_) {
+    if (segment.empty() || segment == "*") {
+      throw std::invalid_argument("invalid index pattern: " + pattern);
+    }
+  }
+  base_.pop_back();
+}
+
+const std::vector<std::string>& secondary_index::base() const {
+  return base_;
+}
+
+const std::string& secondary_index::field() const {
+  return field_;
+}
+
+bool secondary_index::covers(const std::vector<std::string>& base,
+                             const std::string& field) const {
+  return base == base_ && field == field_;
+}
+
+void secondary_index::update(const std::string& key, const std::string& value) {
+  erase(key);
+  values_[key] = value;
+  keys_.insert(std::make_pair(value, key));
+}
+
+void secondary_index::erase(const std::string& key) {
+  auto value_it = values_.find(key);
+  if (value_it == values_.end()) {
+    return;
+  }
+
+  auto range = keys_.equal_range(value_it->second);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second == key) {
+      keys_.erase(it);
+      break;
+    }
+  }
+  values_.erase(value_it);
+}
+
+void secondary_index::clear() {
+  values_.clear();
+  keys_.clear();
+}
+
+std::vector<std::string> secondary_index::find(const std::string& value) const {
+  std::vector<std::string> result;
+  auto range = keys_.equal_range(value);
+  for (auto it = range.first; it != range.second; ++it) {
+    result.push_back(it->second);
+  }
+  return result;
+}
+
+std::vector<std::string> secondary_index::find_range(
+    const std::string& from, const std::string& to) const {
+  std::vector<std::string> result;
+  for (auto it = keys_.lower_bound(from);
+       it != keys_.end() && it->first <= to; ++it) {
+    result.push_back(it->second);
+  }
+  return result;
+}
+
+std::size_t secondary_index::size() const {
+  return values_.size();
+}
+
+}  // namespace dust_server
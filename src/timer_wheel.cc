@@ -0,0 +1,96 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#include "dust-server/timer_wheel.h"
+
+namespace dust_server {
+
+namespace {
+
+/// \return the number of ticks covered by one slot of the given level
+std::uint64_t slot_span(std::size_t level, std::size_t slot_bits) {
+  return std::uint64_t(1) << (level * slot_bits);
+}
+
+}  // namespace
+
+timer_wheel::timer_wheel(std::uint64_t now)
+    : now_(now),
+      size_(0) {
+}
+
+void timer_wheel::schedule(std::uint64_t deadline,
+                           std::vector<std::string> path) {
+  ++size_;
+  insert({ deadline, std::move(path) });
+}
+
+void timer_wheel::insert(entry e) {
+  if (e.deadline <= now_) {
+    ready_.push_back(std::move(e));
+    return;
+  }
+
+  // Find the lowest level that reaches the deadline. Deadlines beyond the
+  // last level are parked in its farthest slot and re-scheduled from there.
+  std::uint64_t delta = e.deadline - now_;
+  std::uint64_t at = e.deadline;
+  std::size_t level = 0;
+  while (level + 1 < kLevels && delta >= slot_span(level + 1, kSlotBits)) {
+    ++level;
+  }
+  if (delta >= slot_span(kLevels, kSlotBits)) {
+    at = now_ + slot_span(kLevels, kSlotBits) - 1;
+  }
+
+  std::size_t index = (at >> (level * kSlotBits)) & (kSlots - 1);
+  levels_[level][index].push_back(std::move(e));
+}
+
+void timer_wheel::cascade(std::size_t level) {
+  std::size_t index = (now_ >> (level * kSlotBits)) & (kSlots - 1);
+  slot entries;
+  entries.swap(levels_[level][index]);
+  for (auto& e : entries) {
+    insert(std::move(e));
+  }
+}
+
+void timer_wheel::advance(std::uint64_t now) {
+  while (now_ < now) {
+    ++now_;
+
+    // Whenever a level wraps around, the next slot of the level above
+    // moves down.
+    for (std::size_t level = 1; level < kLevels; ++level) {
+      if ((now_ & (slot_span(level, kSlotBits) - 1)) != 0) {
+        break;
+      }
+      cascade(level);
+    }
+
+    slot& current = levels_[0][now_ & (kSlots - 1)];
+    for (auto& e : current) {
+      ready_.push_back(std::move(e));
+    }
+    current.clear();
+  }
+}
+
+std::size_t timer_wheel::pop_due(std::size_t max, std::vector<entry>& out) {
+  std::size_t n = 0;
+  while (n < max && !ready_.empty()) {
+    out.push_back(std::move(ready_.front()));
+    ready_.pop_front();
+    ++n;
+  }
+  size_ -= n;
+  return n;
+}
+
+std::size_t timer_wheel::size() const {
+  return size_;
+}
+
+}  // namespace dust_server
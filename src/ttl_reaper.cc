@@ -0,0 +1,30 @@
+// Copyright (c) 2014, makielski.net
+// Licensed under the MIT license
+// https://raw.github.com/makielski/botscript/master/COPYING
+
+#include "dust-server/ttl_reaper.h"
+
+namespace dust_server {
+
+ttl_reaper::ttl_reaper(boost::asio::io_service* io_service,
+                       std::shared_ptr<lua_connection> lua_con,
+                       std::size_t tick_ms, std::size_t batch)
+    : timer_(*io_service),
+      lua_con_(std::move(lua_con)),
+      tick_ms_(tick_ms),
+      batch_(batch) {
+  start_timer(tick_ms_);
+}
+
+void ttl_reaper::start_timer(std::size_t delay_ms) {
+  timer_.expires_from_now(boost::posix_time::milliseconds(delay_ms));
+  timer_.async_wait([this](const boost::system::error_code& ec) {
+    if (ec) {
+      return;
+    }
+    std::size_t processed = lua_con_->expire(batch_);
+    start_timer(processed == batch_ ? 0 : tick_ms_);
+  });
+}
+
+}  // namespace dust_server
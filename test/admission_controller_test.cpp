@@ -0,0 +1,149 @@
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "dust-server/admission_controller.h"
+
+using dust_server::admission_controller;
+
+namespace {
+
+/// Runs dispatched jobs right away on the dispatching thread.
+void run_inline(std::function<void ()> job) {
+  job();
+}
+
+}  // namespace
+
+TEST(admission_controller_test, admit_below_limit) {
+  admission_controller ac(2, 0, std::chrono::milliseconds(0), run_inline);
+  ASSERT_TRUE(ac.try_acquire("a"));
+  ASSERT_TRUE(ac.try_acquire("a"));
+  ASSERT_EQ(2u, ac.running());
+  ac.release();
+  ac.release();
+  ASSERT_EQ(0u, ac.running());
+}
+
+TEST(admission_controller_test, try_acquire_never_queues) {
+  admission_controller ac(1, 10, std::chrono::milliseconds(1000),
+                          run_inline);
+  ASSERT_TRUE(ac.try_acquire("a"));
+  ASSERT_FALSE(ac.try_acquire("b"));
+  ASSERT_EQ(0u, ac.queued());
+  ASSERT_EQ(1u, ac.rejected());
+  ac.release();
+}
+
+TEST(admission_controller_test, reject_when_queue_full) {
+  admission_controller ac(1, 0, std::chrono::milliseconds(1000),
+                          run_inline);
+  ASSERT_TRUE(ac.try_acquire("a"));
+
+  bool called = false, admitted = true;
+  ac.submit("b", [&](bool ok) { called = true; admitted = ok; });
+
+  // Rejected before submit() returns.
+  ASSERT_TRUE(called);
+  ASSERT_FALSE(admitted);
+  ASSERT_EQ(1u, ac.rejected());
+  ac.release();
+}
+
+TEST(admission_controller_test, reject_after_timeout) {
+  admission_controller ac(1, 1, std::chrono::milliseconds(10), run_inline);
+  ASSERT_TRUE(ac.try_acquire("a"));
+
+  bool called = false, admitted = true;
+  ac.submit("b", [&](bool ok) { called = true; admitted = ok; });
+  ASSERT_FALSE(called);
+  ASSERT_EQ(1u, ac.queued());
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  ac.release();
+
+  ASSERT_TRUE(called);
+  ASSERT_FALSE(admitted);
+  ASSERT_EQ(0u, ac.queued());
+  ASSERT_EQ(1u, ac.rejected());
+}
+
+TEST(admission_controller_test, expire_without_release) {
+  admission_controller ac(1, 1, std::chrono::milliseconds(10), run_inline);
+  ASSERT_TRUE(ac.try_acquire("a"));
+
+  bool called = false, admitted = true;
+  ac.submit("b", [&](bool ok) { called = true; admitted = ok; });
+  ac.expire();
+  ASSERT_FALSE(called);
+
+  // The slot stays taken: only expire() can time the waiter out.
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  ac.expire();
+
+  ASSERT_TRUE(called);
+  ASSERT_FALSE(admitted);
+  ASSERT_EQ(0u, ac.queued());
+  ASSERT_EQ(1u, ac.running());
+  ASSERT_EQ(1u, ac.rejected());
+  ac.release();
+}
+
+TEST(admission_controller_test, queued_request_admitted_on_release) {
+  admission_controller ac(1, 1, std::chrono::milliseconds(10000),
+                          run_inline);
+  ASSERT_TRUE(ac.try_acquire("a"));
+
+  bool admitted = false;
+  ac.submit("b", [&](bool ok) {
+    admitted = ok;
+    ac.release();
+  });
+  ASSERT_FALSE(admitted);
+  ac.release();
+
+  ASSERT_TRUE(admitted);
+  ASSERT_EQ(2u, ac.admitted());
+  ASSERT_EQ(0u, ac.running());
+}
+
+TEST(admission_controller_test, submit_runs_right_away_if_idle) {
+  admission_controller ac(1, 0, std::chrono::milliseconds(0), run_inline);
+
+  bool admitted = false;
+  ac.submit("a", [&](bool ok) { admitted = ok; });
+  ASSERT_TRUE(admitted);
+  ASSERT_EQ(1u, ac.running());
+  ac.release();
+}
+
+TEST(admission_controller_test, fair_between_clients) {
+  admission_controller ac(1, 10, std::chrono::milliseconds(10000),
+                          run_inline);
+  ASSERT_TRUE(ac.try_acquire("busy"));
+
+  std::vector<std::string> order;
+  auto enqueue = [&](std::string client, std::string name) {
+    ac.submit(client, [&ac, &order, name](bool ok) {
+      if (ok) {
+        order.push_back(name);
+        ac.release();
+      }
+    });
+  };
+
+  enqueue("busy", "busy1");
+  enqueue("busy", "busy2");
+  enqueue("busy", "busy3");
+  enqueue("quiet", "quiet1");
+  ASSERT_EQ(4u, ac.queued());
+
+  ac.release();
+
+  ASSERT_EQ((std::vector<std::string>{ "quiet1", "busy1", "busy2", "busy3" }),
+            order);
+}
@@ -0,0 +1,178 @@
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "boost/asio.hpp"
+
+#include "dust/storage/mem_store.h"
+
+#include "dust-server/binary_protocol.h"
+#include "dust-server/binary_service.h"
+#include "dust-server/lua_connection.h"
+#include "dust-server/options.h"
+#include "dust-server/script_executor.h"
+
+using boost::asio::ip::tcp;
+using namespace dust_server;
+namespace bp = dust_server::binary_protocol;
+
+namespace {
+
+class binary_options : public options {
+ public:
+  binary_options() : options("127.0.0.1", "0", "mypass") {
+    binary_port_ = "0";
+    clients_["reader"] = "readpass";
+  }
+};
+
+struct response {
+  std::uint32_t id;
+  std::uint8_t status;
+  std::string body;
+};
+
+}  // namespace
+
+class binary_service_test : public testing::Test {
+ public:
+  binary_service_test()
+      : lua_con_(std::make_shared<lua_connection>(
+            std::make_shared<dust::mem_store>())),
+        executor_(std::make_shared<script_executor>(lua_con_,
+                                                    binary_options())),
+        service_(&io_service_, executor_, binary_options()),
+        work_(new boost::asio::io_service::work(io_service_)),
+        thread_([this]() { io_service_.run(); }),
+        socket_(client_io_service_) {
+    tcp::resolver resolver(client_io_service_);
+    socket_.connect(*resolver.resolve(tcp::resolver::query(
+        "127.0.0.1", std::to_string(service_.port()))));
+  }
+
+  ~binary_service_test() {
+    socket_.close();
+    work_.reset();
+    io_service_.stop();
+    thread_.join();
+  }
+
+ protected:
+  void send(std::uint32_t id, std::uint8_t type, const std::string& body) {
+    boost::asio::write(socket_, boost::asio::buffer(bp::message(id, type,
+                                                                body)));
+  }
+
+  response receive() {
+    char header[bp::kHeaderSize];
+    boost::asio::read(socket_, boost::asio::buffer(header));
+    std::string payload(bp::get_u32(header), '\0');
+    boost::asio::read(socket_, boost::asio::buffer(&payload[0],
+                                                   payload.size()));
+    return { bp::get_u32(payload.data()),
+             static_cast<std::uint8_t>(payload[4]),
+             payload.substr(bp::kMessageHeaderSize) };
+  }
+
+  boost::asio::io_service io_service_;
+  std::shared_ptr<lua_connection> lua_con_;
+  std::shared_ptr<script_executor> executor_;
+  binary_service service_;
+  std::unique_ptr<boost::asio::io_service::work> work_;
+  std::thread thread_;
+  boost::asio::io_service client_io_service_;
+  tcp::socket socket_;
+};
+
+TEST_F(binary_service_test, script_requires_auth) {
+  send(1, bp::SCRIPT, "function run(db) return \"x\" end");
+  response r = receive();
+  ASSERT_EQ(1u, r.id);
+  ASSERT_EQ(bp::UNAUTHORIZED, r.status);
+}
+
+TEST_F(binary_service_test, wrong_password) {
+  send(1, bp::AUTH, "admin:wrong");
+  ASSERT_EQ(bp::UNAUTHORIZED, receive().status);
+}
+
+TEST_F(binary_service_test, pipelined_scripts) {
+  send(7, bp::AUTH, "admin:mypass");
+  send(8, bp::SCRIPT, R"(
+function run(db)
+  db:get_document("users").foo = "Hello"
+  return "set"
+end
+)");
+  send(9, bp::SCRIPT, R"(
+function run(db)
+  return db:get_document("users").foo:val()
+end
+)");
+
+  response auth = receive();
+  ASSERT_EQ(7u, auth.id);
+  ASSERT_EQ(bp::OK, auth.status);
+
+  response set = receive();
+  ASSERT_EQ(8u, set.id);
+  ASSERT_EQ("set", set.body);
+
+  response get = receive();
+  ASSERT_EQ(9u, get.id);
+  ASSERT_EQ(bp::OK, get.status);
+  ASSERT_EQ("Hello", get.body);
+}
+
+TEST_F(binary_service_test, client_user) {
+  send(1, bp::AUTH, "reader:readpass");
+  ASSERT_EQ(bp::OK, receive().status);
+  send(2, bp::SCRIPT, "function run(db) return \"x\" end");
+  response r = receive();
+  ASSERT_EQ(2u, r.id);
+  ASSERT_EQ("x", r.body);
+}
+
+TEST_F(binary_service_test, cacheable_script) {
+  lua_con_->enable_result_cache(10);
+  std::string read_script = R"(
+function run(db)
+  return db:get_document("users").foo:val()
+end
+)";
+
+  send(1, bp::AUTH, "admin:mypass");
+  send(2, bp::SCRIPT, R"(
+function run(db)
+  db:get_document("users").foo = "Hello"
+  return "set"
+end
+)");
+  send(3, bp::CACHEABLE_SCRIPT, read_script);
+  send(4, bp::CACHEABLE_SCRIPT, read_script);
+  ASSERT_EQ(bp::OK, receive().status);
+  ASSERT_EQ("set", receive().body);
+
+  response first = receive();
+  response second = receive();
+  ASSERT_EQ(3u, first.id);
+  ASSERT_EQ(4u, second.id);
+  ASSERT_EQ("Hello", first.body);
+  ASSERT_EQ("Hello", second.body);
+  ASSERT_EQ(1u, lua_con_->get_result_cache()->hits());
+}
+
+TEST(binary_service_lifetime_test, destroyed_with_pending_accept) {
+  boost::asio::io_service io_service;
+  auto executor = std::make_shared<script_executor>(
+      std::make_shared<lua_connection>(std::make_shared<dust::mem_store>()),
+      binary_options());
+  std::unique_ptr<binary_service> service(
+      new binary_service(&io_service, executor, binary_options()));
+
+  // The aborted accept completes after the service is gone.
+  service.reset();
+  io_service.run();
+}
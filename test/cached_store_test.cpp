@@ -0,0 +1,78 @@
+#include <memory>
+
+#include "gtest/gtest.h"
+
+#include "dust/document.h"
+#include "dust/storage/mem_store.h"
+#include "dust-server/cached_store.h"
+
+using namespace dust;
+using dust_server::cached_store;
+
+class cached_store_test : public testing::Test {
+ public:
+  cached_store_test()
+      : backend_(std::make_shared<mem_store>()),
+        cache_(std::make_shared<cached_store>(backend_, 2)) {
+  }
+
+ protected:
+  std::shared_ptr<key_value_store> backend_;
+  std::shared_ptr<cached_store> cache_;
+};
+
+TEST_F(cached_store_test, repeated_get_hits) {
+  backend_->set("a", "1");
+
+  ASSERT_EQ("1", cache_->get("a"));
+  ASSERT_EQ("1", cache_->get("a"));
+  ASSERT_TRUE(cache_->contains("a"));
+
+  ASSERT_EQ(2u, cache_->hits());
+  ASSERT_EQ(1u, cache_->misses());
+}
+
+TEST_F(cached_store_test, negative_contains_cached) {
+  ASSERT_FALSE(cache_->contains("a"));
+  ASSERT_FALSE(cache_->contains("a"));
+
+  ASSERT_EQ(1u, cache_->hits());
+  ASSERT_EQ(1u, cache_->misses());
+}
+
+TEST_F(cached_store_test, writes_update_cache) {
+  ASSERT_FALSE(cache_->contains("a"));
+
+  cache_->set("a", "1");
+  ASSERT_TRUE(cache_->contains("a"));
+  ASSERT_EQ("1", cache_->get("a"));
+  ASSERT_EQ("1", backend_->get("a"));
+
+  cache_->remove("a");
+  ASSERT_FALSE(cache_->contains("a"));
+  ASSERT_FALSE(backend_->contains("a"));
+}
+
+TEST_F(cached_store_test, least_recently_used_evicted) {
+  cache_->set("a", "1");
+  cache_->set("b", "2");
+  cache_->get("a");
+  cache_->set("c", "3");
+
+  ASSERT_EQ(2u, cache_->size());
+
+  std::size_t misses = cache_->misses();
+  cache_->get("a");
+  ASSERT_EQ(misses, cache_->misses());
+  cache_->get("b");
+  ASSERT_EQ(misses + 1, cache_->misses());
+}
+
+TEST_F(cached_store_test, documents_through_cache) {
+  document users(cache_, "users");
+  users["foo"]["bar"].assign("Hello");
+
+  ASSERT_EQ("Hello", document(cache_, "users")["foo"]["bar"].val());
+  ASSERT_EQ("Hello", document(backend_, "users")["foo"]["bar"].val());
+  ASSERT_GT(cache_->hit_rate(), 0.0);
+}
@@ -0,0 +1,136 @@
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#include "gtest/gtest.h"
+
+#include "dust/document.h"
+#include "dust/storage/mem_store.h"
+#include "dust-server/document_exporter.h"
+
+using namespace dust;
+using dust_server::document_exporter;
+
+class document_exporter_test : public testing::Test {
+ public:
+  document_exporter_test()
+      : store_(std::make_shared<mem_store>()) {
+    document users(store_, "users");
+    users["foo"]["a"].assign("1");
+    users["foo"]["b"].assign("2");
+    users["foo"]["e"]["XY"].assign("5");
+    users["quote"].assign("say \"hi\"\n");
+  }
+
+ protected:
+  std::shared_ptr<key_value_store> store_;
+};
+
+TEST_F(document_exporter_test, json) {
+  std::ostringstream out;
+  document_exporter exporter(store_, "users", document_exporter::JSON);
+  ASSERT_EQ("", exporter.write(out));
+  ASSERT_EQ(R"({"foo":{"a":"1","b":"2","e":{"XY":"5"}},)"
+            R"("quote":"say \"hi\"\n"})", out.str());
+}
+
+TEST_F(document_exporter_test, json_nonexistent_root) {
+  std::ostringstream out;
+  document_exporter exporter(store_, "nobody", document_exporter::JSON);
+  exporter.write(out);
+  ASSERT_EQ("{}", out.str());
+}
+
+TEST_F(document_exporter_test, ndjson) {
+  std::ostringstream out;
+  document_exporter exporter(store_, "users", document_exporter::NDJSON);
+  ASSERT_EQ("", exporter.write(out));
+  ASSERT_EQ(R"({"key":"foo/a","value":"1"})" "\n"
+            R"({"key":"foo/b","value":"2"})" "\n"
+            R"({"key":"foo/e/XY","value":"5"})" "\n"
+            R"({"key":"quote","value":"say \"hi\"\n"})" "\n", out.str());
+}
+
+TEST_F(document_exporter_test, ndjson_paged) {
+  document_exporter exporter(store_, "users", document_exporter::NDJSON);
+
+  std::ostringstream page1;
+  std::string next = exporter.write(page1, "", 2);
+  ASSERT_EQ("foo/b", next);
+  ASSERT_EQ(R"({"key":"foo/a","value":"1"})" "\n"
+            R"({"key":"foo/b","value":"2"})" "\n", page1.str());
+
+  std::ostringstream page2;
+  next = exporter.write(page2, next, 2);
+  ASSERT_EQ("quote", next);
+  ASSERT_EQ(R"({"key":"foo/e/XY","value":"5"})" "\n"
+            R"({"key":"quote","value":"say \"hi\"\n"})" "\n", page2.str());
+
+  std::ostringstream page3;
+  ASSERT_EQ("", exporter.write(page3, next, 2));
+  ASSERT_EQ("", page3.str());
+}
+
+TEST_F(document_exporter_test, ndjson_out_of_order_inserts) {
+  document scores(store_, "scores");
+  scores["m"].assign("3");
+  scores["c"].assign("1");
+  scores["x"].assign("4");
+  scores["f"].assign("2");
+
+  document_exporter exporter(store_, "scores", document_exporter::NDJSON);
+  std::ostringstream page1;
+  std::string next = exporter.write(page1, "", 2);
+  ASSERT_EQ("f", next);
+  ASSERT_EQ(R"({"key":"c","value":"1"})" "\n"
+            R"({"key":"f","value":"2"})" "\n", page1.str());
+
+  std::ostringstream page2;
+  exporter.write(page2, next, 2);
+  ASSERT_EQ(R"({"key":"m","value":"3"})" "\n"
+            R"({"key":"x","value":"4"})" "\n", page2.str());
+}
+
+TEST_F(document_exporter_test, ndjson_resume_with_new_exporter) {
+  // No previous page: the resume key is looked up level by level.
+  document_exporter exporter(store_, "users", document_exporter::NDJSON);
+  std::ostringstream out;
+  ASSERT_EQ("foo/e/XY", exporter.write(out, "foo/a", 2));
+  ASSERT_EQ(R"({"key":"foo/b","value":"2"})" "\n"
+            R"({"key":"foo/e/XY","value":"5"})" "\n", out.str());
+
+  std::ostringstream missing;
+  document_exporter other(store_, "users", document_exporter::NDJSON);
+  ASSERT_EQ("", other.write(missing, "foo/c", 0));
+  ASSERT_EQ(R"({"key":"foo/e/XY","value":"5"})" "\n"
+            R"({"key":"quote","value":"say \"hi\"\n"})" "\n",
+            missing.str());
+}
+
+TEST_F(document_exporter_test, ndjson_pages_match_full_export) {
+  document_exporter full(store_, "users", document_exporter::NDJSON);
+  std::ostringstream expected;
+  full.write(expected);
+
+  // Same exporter for all pages and a new exporter per page.
+  document_exporter paged(store_, "users", document_exporter::NDJSON);
+  std::ostringstream same, fresh;
+  std::string next_same, next_fresh;
+  do {
+    next_same = paged.write(same, next_same, 1);
+    document_exporter page(store_, "users", document_exporter::NDJSON);
+    next_fresh = page.write(fresh, next_fresh, 1);
+    ASSERT_EQ(next_same, next_fresh);
+  } while (!next_same.empty());
+  ASSERT_EQ(expected.str(), same.str());
+  ASSERT_EQ(expected.str(), fresh.str());
+}
+
+TEST_F(document_exporter_test, json_above_limit) {
+  std::ostringstream out;
+  document_exporter exporter(store_, "users", document_exporter::JSON);
+  ASSERT_THROW(exporter.write(out, "", 3), std::length_error);
+
+  std::ostringstream all;
+  ASSERT_EQ("", exporter.write(all, "", 4));
+}
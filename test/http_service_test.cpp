@@ -0,0 +1,277 @@
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "boost/asio.hpp"
+
+#include "dust/storage/mem_store.h"
+
+#include "dust-server/http_service.h"
+#include "dust-server/options.h"
+#include "dust-server/script_executor.h"
+
+using boost::asio::ip::tcp;
+using namespace dust_server;
+
+namespace {
+
+const char* kPort = "9005";
+
+/// "admin:mypass"
+const char* kAdminAuth = "Basic YWRtaW46bXlwYXNz";
+
+const char* kHello = "function run(db) return \"hello\" end";
+
+class admission_options : public options {
+ public:
+  /// \param max_queue_wait the maximum admission wait in milliseconds
+  explicit admission_options(std::size_t max_queue_wait)
+      : options("127.0.0.1", kPort, "mypass") {
+    max_running_ = 1;
+    max_queued_ = 1;
+    max_queue_wait_ = max_queue_wait;
+  }
+};
+
+struct http_reply {
+  int status;
+  std::map<std::string, std::string> headers;
+  std::string content;
+};
+
+/// Sends one request and reads the reply until the server closes the
+/// connection.
+http_reply request(const std::string& method, const std::string& uri,
+                   const std::string& content) {
+  boost::asio::io_service io_service;
+  tcp::socket socket(io_service);
+  tcp::resolver resolver(io_service);
+  boost::asio::connect(socket, resolver.resolve(
+      tcp::resolver::query("127.0.0.1", kPort)));
+
+  std::ostringstream req;
+  req << method << " " << uri << " HTTP/1.0\r\n"
+      << "Authorization: " << kAdminAuth << "\r\n"
+      << "Content-Length: " << content.size() << "\r\n\r\n" << content;
+  boost::asio::write(socket, boost::asio::buffer(req.str()));
+
+  boost::asio::streambuf buf;
+  boost::system::error_code ec;
+  boost::asio::read(socket, buf, boost::asio::transfer_all(), ec);
+
+  std::istream in(&buf);
+  http_reply rep;
+  std::string version, line;
+  in >> version >> rep.status;
+  std::getline(in, line);
+  while (std::getline(in, line) && line != "\r") {
+    size_t split = line.find(": ");
+    rep.headers[line.substr(0, split)] =
+        line.substr(split + 2, line.size() - split - 3);
+  }
+  std::ostringstream content_out;
+  content_out << in.rdbuf();
+  rep.content = content_out.str();
+  return rep;
+}
+
+/// Waits up to two seconds for the condition to become true.
+bool eventually(std::function<bool ()> condition) {
+  for (int i = 0; i < 200; ++i) {
+    if (condition()) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return condition();
+}
+
+}  // namespace
+
+class http_service_test : public testing::Test {
+ public:
+  explicit http_service_test(std::size_t max_queue_wait = 10000)
+      : service_(&io_service_, std::make_shared<dust::mem_store>(),
+                 admission_options(max_queue_wait)),
+        admission_(service_.executor()->admission()),
+        work_(new boost::asio::io_service::work(io_service_)),
+        thread_([this]() { io_service_.run(); }) {
+  }
+
+  ~http_service_test() {
+    work_.reset();
+    io_service_.stop();
+    thread_.join();
+  }
+
+ protected:
+  boost::asio::io_service io_service_;
+  http_service service_;
+  admission_controller* admission_;
+  std::unique_ptr<boost::asio::io_service::work> work_;
+  std::thread thread_;
+};
+
+class http_service_expiry_test : public http_service_test {
+ public:
+  http_service_expiry_test() : http_service_test(50) {
+  }
+};
+
+TEST_F(http_service_test, script) {
+  http_reply rep = request("POST", "/", kHello);
+  ASSERT_EQ(200, rep.status);
+  ASSERT_EQ("hello", rep.content);
+}
+
+TEST_F(http_service_test, export_pages) {
+  ASSERT_EQ(200, request("POST", "/", R"(
+function run(db)
+  local users = db:get_document("users")
+  users.c = "3"
+  users.a = "1"
+  users.b = "2"
+  return "ok"
+end
+)").status);
+
+  http_reply page1 = request("GET",
+      "/export?root=users&format=ndjson&limit=2", "");
+  ASSERT_EQ(200, page1.status);
+  ASSERT_EQ("application/x-ndjson", page1.headers["Content-Type"]);
+  ASSERT_EQ("b", page1.headers["X-Dust-Next"]);
+  ASSERT_EQ(R"({"key":"a","value":"1"})" "\n"
+            R"({"key":"b","value":"2"})" "\n", page1.content);
+
+  http_reply page2 = request("GET",
+      "/export?root=users&format=ndjson&limit=2&after=b", "");
+  ASSERT_EQ(200, page2.status);
+  ASSERT_EQ(0u, page2.headers.count("X-Dust-Next"));
+  ASSERT_EQ(R"({"key":"c","value":"3"})" "\n", page2.content);
+
+  http_reply json = request("GET", "/export?root=users", "");
+  ASSERT_EQ(200, json.status);
+  ASSERT_EQ("application/json", json.headers["Content-Type"]);
+  ASSERT_EQ(R"({"a":"1","b":"2","c":"3"})", json.content);
+}
+
+TEST_F(http_service_test, export_resumes_after_write) {
+  ASSERT_EQ(200, request("POST", "/", R"(
+function run(db)
+  local users = db:get_document("users")
+  users.a = "1"
+  users.c = "3"
+  return "ok"
+end
+)").status);
+
+  http_reply page1 = request("GET",
+      "/export?root=users&format=ndjson&limit=1", "");
+  ASSERT_EQ("a", page1.headers["X-Dust-Next"]);
+
+  // Written between the pages: the next page is looked up again.
+  ASSERT_EQ(200, request("POST", "/", R"(
+function run(db)
+  db:get_document("users").b = "2"
+  return "ok"
+end
+)").status);
+
+  http_reply page2 = request("GET",
+      "/export?root=users&format=ndjson&after=a", "");
+  ASSERT_EQ(R"({"key":"b","value":"2"})" "\n"
+            R"({"key":"c","value":"3"})" "\n", page2.content);
+}
+
+TEST_F(http_service_test, export_bad_requests) {
+  ASSERT_EQ(200, request("POST", "/", R"(
+function run(db)
+  local users = db:get_document("users")
+  users.a = "1"
+  users.b = "2"
+  users.c = "3"
+  return "ok"
+end
+)").status);
+
+  ASSERT_EQ(400, request("GET", "/export", "").status);
+  ASSERT_EQ(400, request("GET", "/export?format=ndjson", "").status);
+  ASSERT_EQ(400, request("GET", "/export?root=users&limit=0", "").status);
+  ASSERT_EQ(400, request("GET", "/export?root=users&limit=x", "").status);
+
+  // JSON exports aren't paged.
+  http_reply json = request("GET", "/export?root=users&limit=2", "");
+  ASSERT_EQ(400, json.status);
+  ASSERT_EQ("export too large for JSON, use format=ndjson\n", json.content);
+}
+
+TEST_F(http_service_test, export_path_is_exact) {
+  http_reply rep = request("GET", "/exports?root=users", "");
+  ASSERT_NE("application/json", rep.headers["Content-Type"]);
+}
+
+TEST_F(http_service_test, waits_for_execution_slot) {
+  ASSERT_TRUE(admission_->try_acquire("other"));
+
+  http_reply rep;
+  std::thread client([&rep]() { rep = request("POST", "/", kHello); });
+  ASSERT_TRUE(eventually([this]() { return admission_->queued() == 1; }));
+
+  admission_->release();
+  client.join();
+  ASSERT_EQ(200, rep.status);
+  ASSERT_EQ("hello", rep.content);
+}
+
+TEST_F(http_service_test, overloaded) {
+  // Take the only slot and the only queue entry.
+  ASSERT_TRUE(admission_->try_acquire("other"));
+  std::atomic<bool> queued_done(false);
+  service_.executor()->submit("other", kHello, "",
+      [&queued_done](const script_executor::response&) {
+        queued_done = true;
+      });
+  ASSERT_EQ(1u, admission_->queued());
+
+  http_reply rep = request("POST", "/", kHello);
+  ASSERT_EQ(503, rep.status);
+  ASSERT_EQ("1", rep.headers["Retry-After"]);
+
+  http_reply metrics = request("GET", "/metrics", "");
+  ASSERT_EQ(200, metrics.status);
+  ASSERT_NE(std::string::npos,
+            metrics.content.find("dust_admission_running 1\n"));
+  ASSERT_NE(std::string::npos,
+            metrics.content.find("dust_admission_queued 1\n"));
+  ASSERT_NE(std::string::npos,
+            metrics.content.find("dust_admission_rejected_total 1\n"));
+
+  admission_->release();
+  ASSERT_TRUE(eventually([&queued_done]() { return queued_done.load(); }));
+
+  metrics = request("GET", "/metrics", "");
+  ASSERT_NE(std::string::npos,
+            metrics.content.find("dust_admission_queued 0\n"));
+  ASSERT_NE(std::string::npos,
+            metrics.content.find("dust_admission_admitted_total 2\n"));
+}
+
+TEST_F(http_service_expiry_test, queued_request_times_out) {
+  // Nobody releases the slot: the expiry timer has to reject the request.
+  ASSERT_TRUE(admission_->try_acquire("other"));
+
+  http_reply rep = request("POST", "/", kHello);
+  ASSERT_EQ(503, rep.status);
+  ASSERT_EQ("1", rep.headers["Retry-After"]);
+  ASSERT_EQ(0u, admission_->queued());
+  ASSERT_EQ(1u, admission_->rejected());
+
+  admission_->release();
+}
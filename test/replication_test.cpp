@@ -0,0 +1,173 @@
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "boost/asio.hpp"
+
+#include "dust/storage/mem_store.h"
+
+#include "dust-server/lua_connection.h"
+#include "dust-server/options.h"
+#include "dust-server/replication_follower.h"
+#include "dust-server/replication_publisher.h"
+
+using namespace dust_server;
+
+namespace {
+
+class replication_options : public options {
+ public:
+  /// \param primary_port the port of the primary to follow
+  explicit replication_options(std::string primary_port = "")
+      : options("127.0.0.1", "0", "mypass") {
+    replication_port_ = "0";
+    replication_roots_ = { "users" };
+    primary_host_ = "127.0.0.1";
+    primary_port_ = std::move(primary_port);
+  }
+};
+
+/// Waits up to two seconds for the condition to become true.
+bool eventually(std::function<bool ()> condition) {
+  for (int i = 0; i < 200; ++i) {
+    if (condition()) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return condition();
+}
+
+}  // namespace
+
+class replication_test : public testing::Test {
+ public:
+  replication_test()
+      : primary_(std::make_shared<lua_connection>(
+            std::make_shared<dust::mem_store>())),
+        replica_(std::make_shared<lua_connection>(
+            std::make_shared<dust::mem_store>())),
+        work_(new boost::asio::io_service::work(io_service_)) {
+    primary_->apply_script(R"(
+function run(db)
+  db:get_document("users").alice.status = "active"
+  return "ok"
+end
+)");
+
+    // Stale data the snapshot has to replace.
+    replica_->apply_script(R"(
+function run(db)
+  db:get_document("users").mallory.status = "stale"
+  return "ok"
+end
+)");
+    replica_->add_change_listener([this](const std::vector<std::string>& path,
+                                         lua_connection::change c,
+                                         const std::string&) {
+      replica_changes_.emplace_back(path, c);
+    });
+
+    publisher_.reset(new replication_publisher(&io_service_, primary_,
+                                               replication_options()));
+    follower_.reset(new replication_follower(&io_service_, replica_,
+        replication_options(std::to_string(publisher_->port()))));
+    thread_ = std::thread([this]() { io_service_.run(); });
+  }
+
+  ~replication_test() {
+    work_.reset();
+    io_service_.stop();
+    thread_.join();
+  }
+
+ protected:
+  std::string read_status(const std::string& user) {
+    return replica_->apply_script(R"(
+function run(db)
+  return db:get_document("users"):get(")" + user + R"("):get("status"):val()
+end
+)");
+  }
+
+  boost::asio::io_service io_service_;
+  std::shared_ptr<lua_connection> primary_;
+  std::shared_ptr<lua_connection> replica_;
+
+  // Guarded by the mutex of replica_.
+  std::vector<std::pair<std::vector<std::string>, lua_connection::change>>
+      replica_changes_;
+  std::unique_ptr<boost::asio::io_service::work> work_;
+  std::unique_ptr<replication_publisher> publisher_;
+  std::unique_ptr<replication_follower> follower_;
+  std::thread thread_;
+};
+
+TEST_F(replication_test, bootstrap_from_snapshot) {
+  ASSERT_TRUE(eventually([this]() { return follower_->synchronized(); }));
+  ASSERT_EQ("active", read_status("alice"));
+  ASSERT_LE(0, replica_->replication_lag());
+}
+
+TEST_F(replication_test, snapshot_replaces_root_atomically) {
+  ASSERT_TRUE(eventually([this]() { return follower_->synchronized(); }));
+  ASSERT_EQ("false", replica_->apply_script(R"(
+function run(db)
+  return tostring(db:get_document("users"):get("mallory"):exists())
+end
+)"));
+
+  // One change for the whole root: no reader sees it removed.
+  std::lock_guard<std::mutex> lock(replica_->mutex());
+  ASSERT_EQ(1u, replica_changes_.size());
+  ASSERT_EQ(std::vector<std::string>{ "users" }, replica_changes_[0].first);
+  ASSERT_EQ(lua_connection::REPLACE, replica_changes_[0].second);
+}
+
+TEST_F(replication_test, stream_writes) {
+  ASSERT_TRUE(eventually([this]() { return follower_->synchronized(); }));
+
+  primary_->apply_script(R"(
+function run(db)
+  local users = db:get_document("users")
+  users.bob.status = "new"
+  users.alice = nil
+  return "ok"
+end
+)");
+
+  ASSERT_TRUE(eventually([this]() { return follower_->applied_seq() == 2; }));
+  ASSERT_EQ("new", read_status("bob"));
+
+  // The writes came as CHANGE records over the first connection, not
+  // through a reconnect with a new snapshot.
+  ASSERT_EQ(1u, follower_->connections());
+  ASSERT_TRUE(follower_->synchronized());
+  ASSERT_EQ("false", replica_->apply_script(R"(
+function run(db)
+  return tostring(db:get_document("users"):get("alice"):exists())
+end
+)"));
+
+  std::lock_guard<std::mutex> lock(replica_->mutex());
+  ASSERT_EQ(3u, replica_changes_.size());
+  ASSERT_EQ(lua_connection::REPLACE, replica_changes_[0].second);
+  ASSERT_EQ(lua_connection::SET, replica_changes_[1].second);
+  ASSERT_EQ(lua_connection::REMOVE, replica_changes_[2].second);
+}
+
+TEST_F(replication_test, follower_rejects_writes) {
+  std::string result = replica_->apply_script(R"(
+function run(db)
+  db:get_document("users").eve.status = "active"
+  return "written"
+end
+)");
+  ASSERT_TRUE(result.find("read-only replica") != std::string::npos);
+}
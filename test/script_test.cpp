@@ -1,3 +1,4 @@
+#include <cstdint>
 #include <memory>
 
 #include "gtest/gtest.h"
@@ -314,3 +315,476 @@ TEST_F(script_test, missing_run_method) {
   std::string result = lua_con_.apply_script(script);
   ASSERT_EQ("run method not defined", result);
 }
+
+TEST_F(script_test, find_by_index) {
+  lua_con_.add_index("users/*/status");
+
+  std::string script = R"(
+function run(db)
+  local doc = db:get_document("users")
+  doc:get("alice"):get("status"):set("active")
+  doc:get("bob"):get("status"):set("inactive")
+  doc:get("carol"):get("status"):set("active")
+  doc:get("carol"):get("name"):set("Carol")
+
+  local found = db:find("users", "status", "active")
+  return tostring(#found) .. found[0]:index() .. found[1]:get("name"):val()
+end
+)";
+
+  std::string result = lua_con_.apply_script(script);
+  ASSERT_EQ("2aliceCarol", result);
+}
+
+TEST_F(script_test, find_after_write_through_slash_path) {
+  lua_con_.add_index("users/*/status");
+
+  std::string script = R"(
+function run(db)
+  db:get_document("users/alice"):get("status"):set("active")
+  db:get_document("users/bob/status"):set("active")
+  db:get_document("users/bob/status"):set("inactive")
+
+  local found = db:find("users", "status", "active")
+  return tostring(#found) .. found[0]:index()
+end
+)";
+
+  std::string result = lua_con_.apply_script(script);
+  ASSERT_EQ("1alice", result);
+}
+
+TEST_F(script_test, find_after_update_and_remove) {
+  lua_con_.add_index("users/*/status");
+
+  std::string script = R"(
+function run(db)
+  local doc = db:get_document("users")
+  doc:get("alice"):get("status"):set("active")
+  doc:get("bob"):get("status"):set("active")
+  doc:get("carol"):get("status"):set("active")
+
+  doc:get("alice"):get("status"):set("inactive")
+  doc:get("bob"):remove()
+
+  local found = db:find("users", "status", "active")
+  return tostring(#found) .. found[0]:index()
+end
+)";
+
+  std::string result = lua_con_.apply_script(script);
+  ASSERT_EQ("1carol", result);
+}
+
+TEST_F(script_test, find_range) {
+  lua_con_.add_index("users/*/age");
+
+  std::string script = R"(
+function run(db)
+  db:get_document("users"):from_json(
+      '{"a":{"age":"18"},"b":{"age":"25"},"c":{"age":"29"},"d":{"age":"31"}}')
+
+  local found = db:find_range("users", "age", "20", "29")
+  return found[0]:index() .. found[1]:index() .. tostring(#found)
+end
+)";
+
+  std::string result = lua_con_.apply_script(script);
+  ASSERT_EQ("bc2", result);
+}
+
+TEST_F(script_test, find_range_is_lexicographic) {
+  lua_con_.add_index("users/*/age");
+
+  std::string script = R"(
+function run(db)
+  db:get_document("users"):from_json(
+      '{"a":{"age":"9"},"b":{"age":"10"},"c":{"age":"009"}}')
+
+  local found = db:find_range("users", "age", "000", "099")
+  return found[0]:index() .. tostring(#found)
+end
+)";
+
+  std::string result = lua_con_.apply_script(script);
+  ASSERT_EQ("c1", result);
+}
+
+TEST_F(script_test, find_after_write_below_field) {
+  lua_con_.add_index("users/*/status");
+
+  std::string script = R"(
+function run(db)
+  local doc = db:get_document("users")
+  doc:get("alice"):get("status"):set("active")
+  doc:get("bob"):get("status"):set("active")
+  doc:get("carol"):get("status"):set("active")
+  doc:get("dave"):get("status"):set("active")
+
+  -- The field becomes a composite document.
+  db:get_document("users/alice/status/since"):set("2014")
+  -- The child becomes a value.
+  db:get_document("users/bob"):set("gone")
+  -- Other fields don't matter.
+  db:get_document("users/carol/name/first"):set("Carol")
+  -- Removed below the field.
+  db:get_document("users/dave/status/x/y"):set("z")
+  db:get_document("users/dave/status/x"):remove()
+
+  local found = db:find("users", "status", "active")
+  return tostring(#found) .. found[0]:index()
+end
+)";
+
+  std::string result = lua_con_.apply_script(script);
+  ASSERT_EQ("1carol", result);
+}
+
+TEST_F(script_test, index_rebuilt_from_store) {
+  document(store_, "users")["alice"]["status"].assign("active");
+
+  lua_con_.add_index("users/*/status");
+
+  std::string script = R"(
+function run(db)
+  return db:find("users", "status", "active")[0]:index()
+end
+)";
+
+  std::string result = lua_con_.apply_script(script);
+  ASSERT_EQ("alice", result);
+}
+
+TEST_F(script_test, find_without_index) {
+  std::string script = R"(
+function run(db)
+  db:find("users", "status", "active")
+  return "test failed"
+end
+)";
+
+  std::string result = lua_con_.apply_script(script);
+  ASSERT_EQ("error: no index declared for this path and field", result);
+}
+
+TEST_F(script_test, result_cache_hit_and_invalidation) {
+  lua_con_.enable_result_cache(10);
+
+  std::string read_script = R"(
+function run(db)
+  return db:get_document("config"):get("motd"):val()
+end
+)";
+
+  std::string write_script = R"(
+function run(db)
+  db:get_document("config"):get("motd"):set("changed")
+  return "ok"
+end
+)";
+
+  document(store_, "config")["motd"].assign("hello");
+
+  std::string result;
+  ASSERT_FALSE(lua_con_.cached_result("motd", result));
+  ASSERT_EQ("hello", lua_con_.apply_cacheable_script(read_script, "motd"));
+  ASSERT_TRUE(lua_con_.cached_result("motd", result));
+  ASSERT_EQ("hello", result);
+
+  lua_con_.apply_script(write_script);
+  ASSERT_FALSE(lua_con_.cached_result("motd", result));
+  ASSERT_EQ("changed", lua_con_.apply_cacheable_script(read_script, "motd"));
+}
+
+TEST_F(script_test, result_cache_ignores_other_roots) {
+  lua_con_.enable_result_cache(10);
+  document(store_, "config")["motd"].assign("hello");
+
+  std::string read_script = R"(
+function run(db)
+  return db:get_document("config"):get("motd"):val()
+end
+)";
+
+  std::string write_script = R"(
+function run(db)
+  db:get_document("users"):get("foo"):set("bar")
+  return "ok"
+end
+)";
+
+  std::string result;
+  lua_con_.apply_cacheable_script(read_script, "motd");
+  lua_con_.apply_script(write_script);
+  ASSERT_TRUE(lua_con_.cached_result("motd", result));
+}
+
+TEST_F(script_test, result_cache_invalidated_through_slash_path) {
+  lua_con_.enable_result_cache(10);
+  document(store_, "users")["alice"].assign("old");
+
+  std::string read_script = R"(
+function run(db)
+  return db:get_document("users/alice"):val()
+end
+)";
+
+  std::string write_script = R"(
+function run(db)
+  db:get_document("users"):get("alice"):set("new")
+  return "ok"
+end
+)";
+
+  std::string result;
+  ASSERT_EQ("old", lua_con_.apply_cacheable_script(read_script, "alice"));
+  ASSERT_TRUE(lua_con_.cached_result("alice", result));
+
+  lua_con_.apply_script(write_script);
+  ASSERT_FALSE(lua_con_.cached_result("alice", result));
+  ASSERT_EQ("new", lua_con_.apply_cacheable_script(read_script, "alice"));
+}
+
+TEST_F(script_test, result_cache_skips_writing_scripts) {
+  lua_con_.enable_result_cache(10);
+
+  std::string script = R"(
+function run(db)
+  db:get_document("users"):get("foo"):set("bar")
+  return db:get_document("users"):get("foo"):val()
+end
+)";
+
+  std::string result;
+  ASSERT_EQ("bar", lua_con_.apply_cacheable_script(script, "write"));
+  ASSERT_FALSE(lua_con_.cached_result("write", result));
+}
+
+TEST_F(script_test, field_access) {
+  std::string script = R"(
+function run(db)
+  local doc = db:get_document("users")
+  doc.foo.bar = "Hello"
+  doc["foo"]["baz"] = ", World"
+  return doc.foo.bar:val() .. doc["foo"].baz:val()
+end
+)";
+
+  std::string result = lua_con_.apply_script(script);
+  ASSERT_EQ("Hello, World", result);
+}
+
+TEST_F(script_test, field_access_numbers_and_remove) {
+  std::string script = R"(
+function run(db)
+  local doc = db:get_document("users")
+  doc.list[1] = "a"
+  doc.list[2] = 42
+  local before = doc.list[2]:val()
+  doc.list[2] = nil
+  return doc.list[1]:val() .. before .. tostring(doc.list[2]:exists())
+end
+)";
+
+  std::string result = lua_con_.apply_script(script);
+  ASSERT_EQ("a42false", result);
+}
+
+TEST_F(script_test, field_access_mixed_with_methods) {
+  std::string script = R"(
+function run(db)
+  local doc = db:get_document("users")
+  doc.foo:get("bar"):set("x")
+  return doc:get("foo").bar:val() .. doc.foo.bar:index()
+end
+)";
+
+  std::string result = lua_con_.apply_script(script);
+  ASSERT_EQ("xbar", result);
+}
+
+TEST_F(script_test, field_assign_error) {
+  std::string script = R"(
+function run(db)
+  local doc = db:get_document("users")
+  doc.foo.bar = "Hello"
+  doc.foo = "impossible"
+  return "test failed"
+end
+)";
+
+  std::string result = lua_con_.apply_script(script);
+  ASSERT_TRUE(result.find("Can't override value with composite")
+              != std::string::npos);
+}
+
+TEST_F(script_test, script_stats) {
+  std::string script = R"(
+function run(db)
+  local doc = db:get_document("users")
+  doc.foo.bar = "Hello"
+  return doc.foo.bar:val()
+end
+)";
+
+  dust_server::script_stats stats;
+  ASSERT_EQ("Hello", lua_con_.apply_script(script, &stats));
+  ASSERT_GT(stats.reads, 0u);
+  ASSERT_GT(stats.writes, 0u);
+  ASSERT_GE(stats.bytes_read, 5u);
+  ASSERT_GE(stats.bytes_written, 5u);
+  ASSERT_EQ(0u, stats.removes);
+  // One document each for the written and the read leaf.
+  ASSERT_EQ(2u, stats.documents);
+  ASSERT_GT(stats.lua_memory_peak, 0u);
+  ASSERT_GE(stats.compile_ms, 0.0);
+  ASSERT_GE(stats.execute_ms, 0.0);
+}
+
+TEST_F(script_test, script_stats_on_error) {
+  std::string script = R"(
+function run(db)
+  return db:get_document("users"):get("non"):val()
+end
+)";
+
+  dust_server::script_stats stats;
+  lua_con_.apply_script(script, &stats);
+  ASSERT_GT(stats.reads, 0u);
+  ASSERT_EQ(0u, stats.writes);
+}
+
+TEST_F(script_test, ttl_expired_reads_as_nonexistent) {
+  std::uint64_t now = 1000;
+  lua_con_.set_clock([&now]() { return now; });
+  lua_con_.apply_script(R"(
+function run(db)
+  local sessions = db:get_document("sessions")
+  sessions:get("a"):set("x", 0.05)
+  sessions.b = "y"
+  return "ok"
+end
+)");
+
+  std::string script = R"(
+function run(db)
+  local sessions = db:get_document("sessions")
+  return tostring(sessions.a:exists()) .. " " .. #sessions:children()
+end
+)";
+  ASSERT_EQ("true 2", lua_con_.apply_script(script));
+
+  // Reads check the deadline themselves, before the reaper ran.
+  now += 100;
+  ASSERT_EQ("false 1", lua_con_.apply_script(script));
+
+  // The reaper removes the expired document from the store.
+  ASSERT_EQ(1u, lua_con_.expire(10));
+  ASSERT_EQ(0u, lua_con_.ttl_count());
+  ASSERT_FALSE(document(store_, "sessions")["a"].exists());
+  ASSERT_TRUE(document(store_, "sessions")["b"].exists());
+}
+
+TEST_F(script_test, ttl_removed_by_write) {
+  std::uint64_t now = 1000;
+  lua_con_.set_clock([&now]() { return now; });
+  std::string script = R"(
+function run(db)
+  local doc = db:get_document("limits")
+  doc.client = "1"
+  doc.client:set_ttl(0.05)
+  doc.client = "2"
+  return "ok"
+end
+)";
+  ASSERT_EQ("ok", lua_con_.apply_script(script));
+  ASSERT_EQ(0u, lua_con_.ttl_count());
+
+  now += 200;
+  lua_con_.expire(10);
+  ASSERT_EQ("2", lua_con_.apply_script(R"(
+function run(db)
+  return db:get_document("limits").client:val()
+end
+)"));
+}
+
+TEST_F(script_test, ttl_of_nonexistent_document) {
+  std::string result = lua_con_.apply_script(R"(
+function run(db)
+  db:get_document("none"):set_ttl(10)
+  return "ok"
+end
+)");
+  ASSERT_TRUE(result.find("Database value does not exist")
+              != std::string::npos);
+}
+
+TEST_F(script_test, ttl_must_be_finite) {
+  document(store_, "limits")["client"].assign("1");
+
+  for (const std::string ttl : { "0/0", "math.huge", "-math.huge" }) {
+    std::string result = lua_con_.apply_script(R"(
+function run(db)
+  db:get_document("limits").client:set_ttl()" + ttl + R"()
+  return "ok"
+end
+)");
+    ASSERT_TRUE(result.find("finite") != std::string::npos) << ttl;
+
+    result = lua_con_.apply_script(R"(
+function run(db)
+  db:get_document("limits").client:set("2", )" + ttl + R"()
+  return "ok"
+end
+)");
+    ASSERT_TRUE(result.find("finite") != std::string::npos) << ttl;
+  }
+  ASSERT_EQ(0u, lua_con_.ttl_count());
+  ASSERT_EQ("1", document(store_, "limits")["client"].val());
+}
+
+TEST_F(script_test, huge_ttl_is_clamped) {
+  ASSERT_EQ("ok", lua_con_.apply_script(R"(
+function run(db)
+  db:get_document("limits").client:set("1", 1e300)
+  return "ok"
+end
+)"));
+  ASSERT_EQ(1u, lua_con_.ttl_count());
+  ASSERT_EQ("1", lua_con_.apply_script(R"(
+function run(db)
+  return db:get_document("limits").client:val()
+end
+)"));
+}
+
+TEST_F(script_test, get_many) {
+  std::string script = R"(
+function run(db)
+  local users = db:get_document("users")
+  users.alice.name = "Alice"
+  users.bob.name = "Bob"
+
+  local r = db:get_many({ "users/bob/name", "users/alice/name",
+                          "users/eve/name", "users/bob/name", "users/alice" })
+  return r[1].value .. r[2].value .. tostring(r[3].exists) .. r[4].value
+         .. tostring(r[5].exists) .. tostring(r[5].value)
+end
+)";
+
+  std::string result = lua_con_.apply_script(script);
+  ASSERT_EQ("BobAlicefalseBobtruenil", result);
+}
+
+TEST_F(script_test, get_many_requires_table) {
+  std::string script = R"(
+function run(db)
+  db:get_many("users/alice/name")
+  return "test failed"
+end
+)";
+
+  std::string result = lua_con_.apply_script(script);
+  ASSERT_TRUE(result.find("usage: get_many") != std::string::npos);
+}
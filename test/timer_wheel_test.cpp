@@ -0,0 +1,83 @@
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "dust-server/timer_wheel.h"
+
+using dust_server::timer_wheel;
+
+namespace {
+
+std::vector<std::string> due_paths(timer_wheel& wheel, std::size_t max) {
+  std::vector<timer_wheel::entry> due;
+  wheel.pop_due(max, due);
+  std::vector<std::string> paths;
+  for (const auto& e : due) {
+    paths.push_back(e.path.front());
+  }
+  return paths;
+}
+
+}  // namespace
+
+TEST(timer_wheel_test, entries_become_due_at_deadline) {
+  timer_wheel wheel(1000);
+  wheel.schedule(1010, { "a" });
+  wheel.schedule(1005, { "b" });
+
+  wheel.advance(1004);
+  ASSERT_TRUE(due_paths(wheel, 10).empty());
+
+  wheel.advance(1005);
+  ASSERT_EQ(std::vector<std::string>({ "b" }), due_paths(wheel, 10));
+
+  wheel.advance(1020);
+  ASSERT_EQ(std::vector<std::string>({ "a" }), due_paths(wheel, 10));
+  ASSERT_EQ(0u, wheel.size());
+}
+
+TEST(timer_wheel_test, past_deadline_is_due_immediately) {
+  timer_wheel wheel(50);
+  wheel.schedule(10, { "a" });
+  ASSERT_EQ(std::vector<std::string>({ "a" }), due_paths(wheel, 10));
+}
+
+TEST(timer_wheel_test, far_deadlines_cascade) {
+  timer_wheel wheel(0);
+  wheel.schedule(70, { "level1" });
+  wheel.schedule(5000, { "level2" });
+  wheel.schedule(300000, { "level3" });
+  wheel.schedule(20000000, { "beyond" });
+
+  wheel.advance(69);
+  ASSERT_TRUE(due_paths(wheel, 10).empty());
+  wheel.advance(70);
+  ASSERT_EQ(std::vector<std::string>({ "level1" }), due_paths(wheel, 10));
+
+  wheel.advance(4999);
+  ASSERT_TRUE(due_paths(wheel, 10).empty());
+  wheel.advance(5000);
+  ASSERT_EQ(std::vector<std::string>({ "level2" }), due_paths(wheel, 10));
+
+  wheel.advance(300000);
+  ASSERT_EQ(std::vector<std::string>({ "level3" }), due_paths(wheel, 10));
+
+  wheel.advance(19999999);
+  ASSERT_TRUE(due_paths(wheel, 10).empty());
+  wheel.advance(20000000);
+  ASSERT_EQ(std::vector<std::string>({ "beyond" }), due_paths(wheel, 10));
+}
+
+TEST(timer_wheel_test, bounded_batches) {
+  timer_wheel wheel(0);
+  for (int i = 0; i < 5; ++i) {
+    wheel.schedule(1, { std::to_string(i) });
+  }
+  wheel.advance(1);
+
+  ASSERT_EQ(2u, due_paths(wheel, 2).size());
+  ASSERT_EQ(3u, wheel.size());
+  ASSERT_EQ(3u, due_paths(wheel, 10).size());
+  ASSERT_EQ(0u, wheel.size());
+}